@@ -0,0 +1,1367 @@
+#include "main.h"
+#include "restaurant.cpp"
+#include <malloc.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+// build: g++ -O2 -pthread -o benchmark src/benchmark.cpp
+// usage: ./benchmark capacity [max_capacity]
+//        ./benchmark huffman [lookups]
+//        ./benchmark huffman-build [max_bytes]
+//        ./benchmark huffman-codec [max_bytes]
+//        ./benchmark lru [max_capacity]
+//        ./benchmark hash [slots]
+//        ./benchmark ingest [lines]
+//        ./benchmark wipe [max_capacity]
+//        ./benchmark sharded [max_threads] [instances] [ops_per_instance]
+//        ./benchmark pipeline [max_threads] [lines]
+//        ./benchmark live [max_readers] [ops] [capacity]
+//        ./benchmark server [max_clients] [ops_per_client] [depth]
+//        ./benchmark print [max_capacity] [rounds]
+//        ./benchmark customer [max_capacity]
+//        ./benchmark avl [entries]
+//        ./benchmark snapshot [max_capacity]
+//        ./benchmark wal [commands]
+//        ./benchmark crash [rounds]
+//        ./benchmark workload [--ops N] [--capacity N] [--min-name N] [--max-name N]
+//                             [--names N] [--zipf S] [--repeat P] [--reg P] [--cle P]
+//                             [--print P] [--wipe P] [--seed N]
+
+// heap bytes in use while count_heap is on. Only benchmark customer turns it
+// on, single threaded, so the other modes never touch the shared counter
+bool count_heap = false;
+atomic<long long> heap_bytes(0);
+
+void* operator new(size_t size) {
+	void* p = malloc(size ? size : 1);
+	if (p == nullptr) {
+		throw bad_alloc();
+	}
+	if (count_heap) {
+		heap_bytes += malloc_usable_size(p);
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	if (p != nullptr) {
+		if (count_heap) {
+			heap_bytes -= malloc_usable_size(p);
+		}
+		free(p);
+	}
+}
+
+void operator delete(void* p, size_t) noexcept {
+	operator delete(p);
+}
+
+// hardware cache misses of this thread, -1 where perf events are not allowed
+class CacheMissCounter {
+private:
+	int fd;
+public:
+	CacheMissCounter() {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	~CacheMissCounter() {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+
+	void start() {
+		if (fd >= 0) {
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+
+	long long stop() {
+		if (fd < 0) {
+			return -1;
+		}
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		long long count = 0;
+		if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+			return -1;
+		}
+		return count;
+	}
+};
+
+string randomName(mt19937& rng, int length) {
+	string name(length, 'a');
+	for (char& x : name) {
+		x = 'a' + rng() % 26;
+	}
+	return name;
+}
+
+// REG/CLE mix for one restaurant size: fill every table, then repeat orders,
+// single-table clears and refills until ops commands have been written
+void writeRegCleWorkload(string filename, int capacity, int ops) {
+	mt19937 rng(capacity);
+	vector<string> names;
+	for (int i = 0; i < capacity; i++) {
+		names.push_back(randomName(rng, 8));
+	}
+	ofstream out(filename);
+	for (int i = 0; i < ops; i++) {
+		int op = rng() % 10;
+		if (i < capacity || op < 5) {
+			out << "REG " << names[rng() % names.size()] << "\n";
+		} else if (op < 8) {
+			out << "REG " << randomName(rng, 8) << "\n";
+		} else {
+			out << "CLE " << rng() % capacity + 1 << "\n";
+		}
+	}
+}
+
+void benchCapacity(int max_capacity) {
+	cout << "capacity,commands,seconds,commands_per_sec" << endl;
+	for (int capacity : {32, 1024, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		int ops = max(2 * capacity, 20000);
+		string filename = "bench_capacity.txt";
+		writeRegCleWorkload(filename, capacity, ops);
+
+		auto start = chrono::steady_clock::now();
+		simulate(filename, capacity);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		cout << capacity << "," << ops << "," << seconds << "," << ops / seconds << endl;
+		remove(filename.c_str());
+	}
+}
+
+// names/sec for the REG result of returning customers: 90% of the lookups
+// go to 10% of the names
+void benchHuffman(int lookups) {
+	mt19937 rng(1);
+	vector<string> names;
+	for (int i = 0; i < 10000; i++) {
+		names.push_back(randomName(rng, 4 + rng() % 12));
+	}
+	vector<int> order;
+	for (int i = 0; i < lookups; i++) {
+		if (rng() % 10 < 9) {
+			order.push_back(rng() % (names.size() / 10));
+		} else {
+			order.push_back(rng() % names.size());
+		}
+	}
+
+	cout << "method,names,seconds,names_per_sec,checksum" << endl;
+	long long checksum = 0;
+	auto start = chrono::steady_clock::now();
+	for (int i : order) {
+		string Huff_string = getHuffString(names[i]);
+		if (Huff_string.size() > 15) {
+			Huff_string = Huff_string.substr(Huff_string.size() - 15);
+		}
+		checksum += convertBinToDec(Huff_string);
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "getHuffString," << lookups << "," << seconds << "," << lookups / seconds << "," << checksum << endl;
+
+	checksum = 0;
+	start = chrono::steady_clock::now();
+	for (int i : order) {
+		checksum += getHuffResult(names[i]);
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "getHuffResult," << lookups << "," << seconds << "," << lookups / seconds << "," << checksum << endl;
+
+	HuffArena arena;
+	checksum = 0;
+	start = chrono::steady_clock::now();
+	for (int i : order) {
+		checksum += arena.getResult(names[i]);
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "HuffArena," << lookups << "," << seconds << "," << lookups / seconds << "," << checksum << endl;
+
+	HuffCache huff_cache(4096);
+	checksum = 0;
+	start = chrono::steady_clock::now();
+	for (int i : order) {
+		checksum += huff_cache.getResult(names[i]);
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "HuffCache," << lookups << "," << seconds << "," << lookups / seconds << "," << checksum << endl;
+	cout << "cache hits " << huff_cache.getHits() << ", misses " << huff_cache.getMisses() << endl;
+}
+
+// skewed byte payload: low byte values are much more frequent than high ones
+string randomPayload(mt19937& rng, int size) {
+	geometric_distribution<int> symbol(0.05);
+	string payload(size, 0);
+	for (char& x : payload) {
+		x = (char)min(symbol(rng), 255);
+	}
+	return payload;
+}
+
+// tree construction only, MB/s of input for payloads from 8 bytes to max_bytes
+void benchHuffmanBuild(int max_bytes) {
+	mt19937 rng(1);
+	cout << "bytes,method,mb_per_sec" << endl;
+	for (int size : {8, 64, 512, 4 << 10, 32 << 10, 256 << 10, 1 << 20}) {
+		if (size > max_bytes) {
+			break;
+		}
+		string payload = randomPayload(rng, size);
+		int repeats = max(1, (16 << 20) / size);
+		double mb = (double)size * repeats / (1 << 20);
+		long long checksum = 0;
+
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			HuffTree<char>* tree = buildHuffTree(payload);
+			checksum += tree->freq();
+			delete tree;
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << size << ",buildHuffTree," << mb / seconds << endl;
+
+		for (bool two_queue : {false, true}) {
+			HuffArena arena(two_queue);
+			start = chrono::steady_clock::now();
+			for (int i = 0; i < repeats; i++) {
+				checksum += arena.build(payload);
+			}
+			seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			cout << size << "," << (two_queue ? "HuffArena two-queue," : "HuffArena heap,") << mb / seconds << endl;
+		}
+		if (checksum == 42) { // keeps the builds from being optimized away
+			cout << endl;
+		}
+	}
+}
+
+// MB/s of input for encoding and decoding payloads of 1 MB and up, and the
+// size of the packed output; getHuffString is the '0'/'1' string it replaces
+void benchHuffmanCodec(int max_bytes) {
+	mt19937 rng(1);
+	cout << "bytes,method,mb_per_sec,output_bytes" << endl;
+	HuffCodec codec;
+	HuffEncoded encoded;
+	for (int size : {1 << 20, 4 << 20, 16 << 20, 64 << 20}) {
+		if (size > max_bytes) {
+			break;
+		}
+		string payload = randomPayload(rng, size);
+		double mb = (double)size / (1 << 20);
+		int repeats = max(1, (64 << 20) / size);
+
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			codec.encode(payload, encoded);
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repeats;
+		cout << size << ",HuffCodec::encode," << mb / seconds << "," << encoded.bits.size() << endl;
+
+		string decoded;
+		bool ok = true;
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < repeats; i++) {
+			ok = codec.decode(encoded, decoded) && ok;
+		}
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repeats;
+		cout << size << ",HuffCodec::decode," << mb / seconds << "," << encoded.bits.size()
+			 << (ok && decoded == payload ? "" : ",MISMATCH") << endl;
+
+		if (size <= (4 << 20)) {
+			start = chrono::steady_clock::now();
+			size_t bits = getHuffString(payload).size();
+			seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			cout << size << ",getHuffString," << mb / seconds << "," << bits << endl;
+		}
+	}
+}
+
+// ns per LRCO operation on a full list: a repeat order (move to back) or an
+// eviction of the least recent customer followed by a new one
+void benchLRU(int max_capacity) {
+	mt19937 rng(1);
+	cout << "capacity,ns_per_repeat_order,ns_per_evict_insert" << endl;
+	for (int capacity : {1000, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		LinkedList LRCO(&Customer::lrco);
+		vector<Customer> customers(capacity);
+		for (int i = 0; i < capacity; i++) {
+			customers[i].reset(i + 1, i, area1);
+			LRCO.pushBack(&customers[i]);
+		}
+		int ops = 1000000;
+		vector<int> order;
+		for (int i = 0; i < ops; i++) {
+			order.push_back(rng() % capacity);
+		}
+
+		auto start = chrono::steady_clock::now();
+		for (int i : order) {
+			LRCO.moveToBack(&customers[i]);
+		}
+		double repeat_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < ops; i++) {
+			Customer* evicted = LRCO.getHead();
+			LRCO.removeHead();
+			evicted->reset(i % capacity + 1, i, area1);
+			LRCO.pushBack(evicted);
+		}
+		double evict_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ops;
+
+		cout << capacity << "," << repeat_ns << "," << evict_ns << endl;
+	}
+}
+
+// area 1 probe lengths and keyed lookup cost at rising load, after a round of
+// removes and re-inserts so tombstones / backward shifts are exercised
+void benchHash(int slots) {
+	mt19937 rng(1);
+	cout << "mode,load,avg_probes,max_probes,ns_per_find" << endl;
+	for (bool robin_hood : {false, true}) {
+		for (double load : {0.5, 0.9, 0.99, 1.0}) {
+			HashTable area_1(slots, robin_hood);
+			int count = slots * load;
+			vector<Customer> customers(count);
+			int ID = 1;
+			for (Customer& customer : customers) {
+				customer.reset(ID++, rng() % 32768, area1);
+				area_1.insert(&customer);
+			}
+			for (int i = 0; i < count; i++) {
+				Customer* victim = &customers[rng() % count];
+				area_1.remove(victim);
+				victim->reset(ID++, rng() % 32768, area1);
+				area_1.insert(victim);
+			}
+
+			HashTable::ProbeStats stats = area_1.getProbeStats();
+			int finds = 200000;
+			long long found = 0;
+			auto start = chrono::steady_clock::now();
+			for (int i = 0; i < finds; i++) {
+				Customer* customer = &customers[rng() % count];
+				found += area_1.find(customer->result, customer->ID) == customer;
+			}
+			double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / finds;
+			cout << (robin_hood ? "robin_hood," : "linear,") << load << "," << stats.average << "," << stats.max << "," << ns << (found == finds ? "" : ",MISSING") << endl;
+		}
+	}
+}
+
+// lines/sec of reading and dispatching a command file, no restaurant work
+void benchIngest(int lines) {
+	mt19937 rng(1);
+	string filename = "bench_ingest.txt";
+	{
+		ofstream out(filename);
+		for (int i = 0; i < lines; i++) {
+			int op = rng() % 20;
+			if (op < 14) {
+				out << "REG " << randomName(rng, 4 + rng() % 16) << "\n";
+			} else if (op < 18) {
+				out << "CLE " << rng() % 1000 << "\n";
+			} else {
+				out << (op == 18 ? "PrintHT" : "PrintMH") << "\n";
+			}
+		}
+	}
+	cout << "reader,lines,seconds,lines_per_sec" << endl;
+
+	long long counts[cmdUnknown + 1] = {0};
+	auto start = chrono::steady_clock::now();
+	ifstream myfile(filename);
+	string command;
+	while (getline(myfile, command)) {
+		string key = command.substr(0, command.find(" "));
+		if (key == "REG") {
+			counts[cmdREG]++;
+		} else if (key == "CLE") {
+			counts[cmdCLE]++;
+		} else if (key == "PrintHT") {
+			counts[cmdPrintHT]++;
+		} else if (key == "PrintAVL") {
+			counts[cmdPrintAVL]++;
+		} else if (key == "PrintMH") {
+			counts[cmdPrintMH]++;
+		} else {
+			counts[cmdUnknown]++;
+		}
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "ifstream+getline," << lines << "," << seconds << "," << lines / seconds << endl;
+
+	long long check = counts[cmdREG];
+	fill(counts, counts + cmdUnknown + 1, 0);
+	start = chrono::steady_clock::now();
+	CommandReader reader(filename);
+	string_view line;
+	while (reader.next(line)) {
+		counts[getCommand(line.substr(0, line.find(" ")))]++;
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "CommandReader," << lines << "," << seconds << "," << lines / seconds << (check == counts[cmdREG] ? "" : ",MISMATCH") << endl;
+	remove(filename.c_str());
+}
+
+// ms for CLE area wipes on a full restaurant, each area holds half the customers,
+// removing from LFCO one by one (reference PrintMH order) and with setHeapifyWipe.
+// The area 2 wipe empties the restaurant, so it rebuilds LFCO either way
+void benchWipe(int max_capacity) {
+	cout << "capacity,customers_area_1,heapify,ms_area_1,ms_area_2" << endl;
+	for (int capacity : {1000, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		for (bool heapify : {false, true}) {
+			mt19937 rng(1);
+			Restaurant restaurant(capacity);
+			restaurant.setHeapifyWipe(heapify);
+			for (int i = 0; i < capacity; i++) {
+				restaurant.execute("REG " + randomName(rng, 12));
+			}
+			string wipe_2 = "CLE " + to_string(capacity + 1);
+
+			auto start = chrono::steady_clock::now();
+			restaurant.execute("CLE 0");
+			double ms_1 = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			start = chrono::steady_clock::now();
+			restaurant.execute(wipe_2);
+			double ms_2 = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			cout << capacity << "," << capacity / 2 << "," << heapify << "," << ms_1 << "," << ms_2 << endl;
+		}
+	}
+}
+
+// knobs of the synthetic REG/CLE/Print* mix
+class WorkloadConfig {
+public:
+	int ops = 1000000;
+	int capacity = 1024;
+	int min_name = 4;       // name length range
+	int max_name = 16;
+	int names = 0;          // returning customers to pick from, 0 = 4 * capacity
+	double zipf = 1.0;      // skew of which returning customer comes back
+	double repeat = 0.7;    // share of REG that are returning customers
+	double reg = 0.8;       // command mix, normalized
+	double cle = 0.15;
+	double print = 0.05;    // split evenly between PrintHT/PrintAVL/PrintMH
+	double wipe = 0.02;     // share of CLE that clear a whole area
+	int seed = 1;
+
+	// --key value pairs, returns false on an unknown key
+	bool parse(int argc, char* argv[], int first) {
+		for (int i = first; i + 1 < argc; i += 2) {
+			string key = argv[i];
+			double value = stod(argv[i + 1]);
+			if (key == "--ops") ops = value;
+			else if (key == "--capacity") capacity = value;
+			else if (key == "--min-name") min_name = value;
+			else if (key == "--max-name") max_name = value;
+			else if (key == "--names") names = value;
+			else if (key == "--zipf") zipf = value;
+			else if (key == "--repeat") repeat = value;
+			else if (key == "--reg") reg = value;
+			else if (key == "--cle") cle = value;
+			else if (key == "--print") print = value;
+			else if (key == "--wipe") wipe = value;
+			else if (key == "--seed") seed = value;
+			else return false;
+		}
+		return true;
+	}
+};
+
+class WorkloadGenerator {
+private:
+	WorkloadConfig config;
+	mt19937 rng;
+	vector<string> names;
+	vector<double> zipf_cdf; // zipf_cdf[k] = P(rank <= k)
+
+	double uniform() {
+		return uniform_real_distribution<double>(0, 1)(rng);
+	}
+
+	string newName() {
+		return randomName(rng, config.min_name + rng() % (config.max_name - config.min_name + 1));
+	}
+public:
+	WorkloadGenerator(WorkloadConfig config) : config(config), rng(config.seed) {
+		int count = config.names > 0 ? config.names : 4 * config.capacity;
+		double total = 0;
+		for (int k = 1; k <= count; k++) {
+			names.push_back(newName());
+			total += 1 / pow(k, config.zipf);
+			zipf_cdf.push_back(total);
+		}
+		for (double& x : zipf_cdf) {
+			x /= total;
+		}
+	}
+
+	string next() {
+		double mix = uniform() * (config.reg + config.cle + config.print);
+		if (mix < config.reg) {
+			if (uniform() < config.repeat) {
+				int rank = lower_bound(zipf_cdf.begin(), zipf_cdf.end(), uniform()) - zipf_cdf.begin();
+				return "REG " + names[min(rank, (int)names.size() - 1)];
+			}
+			return "REG " + newName();
+		}
+		if (mix < config.reg + config.cle) {
+			if (uniform() < config.wipe) {
+				return rng() % 2 ? "CLE 0" : "CLE " + to_string(config.capacity + 1);
+			}
+			return "CLE " + to_string(rng() % config.capacity + 1);
+		}
+		const char* prints[] = {"PrintHT", "PrintAVL", "PrintMH"};
+		return prints[rng() % 3];
+	}
+};
+
+// swallows the Print* output so only formatting is measured
+class NullBuffer : public streambuf {
+protected:
+	int overflow(int c) {
+		return c;
+	}
+	streamsize xsputn(const char*, streamsize n) {
+		return n;
+	}
+};
+
+long long percentile(vector<long long>& sorted, double p) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	return sorted[min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+// ops/sec and latency percentiles per command type over a generated workload
+void benchWorkload(WorkloadConfig config) {
+	WorkloadGenerator generator(config);
+	vector<string> commands;
+	for (int i = 0; i < config.ops; i++) {
+		commands.push_back(generator.next());
+	}
+
+	Restaurant restaurant(config.capacity);
+	vector<long long> latencies[cmdUnknown + 1];
+	NullBuffer null_buffer;
+	streambuf* old_buffer = cout.rdbuf(&null_buffer);
+	auto begin = chrono::steady_clock::now();
+	for (const string& command : commands) {
+		auto start = chrono::steady_clock::now();
+		Command type = restaurant.execute(command);
+		latencies[type].push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+	cout.rdbuf(old_buffer);
+
+	const char* labels[] = {"REG", "CLE", "PrintHT", "PrintAVL", "PrintMH", "SNP", "unknown"};
+	cout << "command,count,ops_per_sec,p50_ns,p99_ns,p999_ns" << endl;
+	for (int type = 0; type < cmdUnknown; type++) {
+		vector<long long>& sorted = latencies[type];
+		if (sorted.empty()) {
+			continue;
+		}
+		sort(sorted.begin(), sorted.end());
+		double busy = accumulate(sorted.begin(), sorted.end(), 0.0) / 1e9;
+		cout << labels[type] << "," << sorted.size() << "," << sorted.size() / busy << ","
+			 << percentile(sorted, 0.5) << "," << percentile(sorted, 0.99) << "," << percentile(sorted, 0.999) << endl;
+	}
+	cout << "all," << config.ops << "," << config.ops / seconds << ",,," << endl;
+}
+
+// lines/sec of each Print command on a full restaurant, cout goes to a file
+// so the cost of flushing is part of the measurement
+void benchPrint(int max_capacity, int rounds) {
+	const char* prints[] = {"PrintHT", "PrintAVL", "PrintMH"};
+	string filename = "benchmark_print.out";
+	cout << "command,capacity,lines,seconds,lines_per_sec,mb_per_sec" << endl;
+	for (int capacity : {1000, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		Restaurant restaurant(capacity);
+		mt19937 rng(capacity);
+		for (int i = 0; i < capacity; i++) {
+			restaurant.execute("REG " + randomName(rng, 8));
+		}
+		for (const char* print : prints) {
+			ofstream file(filename);
+			streambuf* old_buffer = cout.rdbuf(file.rdbuf());
+			auto start = chrono::steady_clock::now();
+			for (int i = 0; i < rounds; i++) {
+				restaurant.execute(print);
+			}
+			cout.flush();
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			cout.rdbuf(old_buffer);
+			file.close();
+
+			ifstream in(filename, ios::binary | ios::ate);
+			long long bytes = in.tellg();
+			long long lines = 0;
+			in.seekg(0);
+			string line;
+			while (getline(in, line)) {
+				lines++;
+			}
+			cout << print << "," << capacity << "," << lines << "," << seconds << ","
+				 << lines / seconds << "," << bytes / seconds / 1e6 << endl;
+		}
+	}
+	remove(filename.c_str());
+}
+
+// heap bytes per seated customer of a full restaurant, then ns and cache
+// misses per REG for a mix of repeat orders and new customers that evict
+void benchCustomer(int max_capacity) {
+	cout << "capacity,bytes_per_customer,regs,ns_per_reg,cache_misses_per_reg" << endl;
+	for (int capacity : {1000, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		mt19937 rng(capacity);
+		vector<string> names;
+		for (int i = 0; i < 2 * capacity; i++) {
+			names.push_back("REG " + randomName(rng, 12));
+		}
+		int regs = max(4 * capacity, 1000000);
+		vector<int> order;
+		for (int i = 0; i < regs; i++) {
+			order.push_back(rng() % names.size());
+		}
+
+		// a block allocated before counting and freed during it would skew the count,
+		// everything the restaurant allocates is freed by the delete below
+		heap_bytes = 0;
+		count_heap = true;
+		long long empty = heap_bytes;
+		Restaurant* restaurant = new Restaurant(capacity);
+		long long before = heap_bytes;
+		for (int i = 0; i < capacity; i++) {
+			restaurant->execute(names[i]);
+		}
+		double bytes = (double)(heap_bytes - before) / capacity;
+
+		CacheMissCounter misses;
+		misses.start();
+		auto start = chrono::steady_clock::now();
+		for (int i : order) {
+			restaurant->execute(names[i]);
+		}
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / regs;
+		long long miss_count = misses.stop();
+		delete restaurant;
+		count_heap = false;
+
+		cout << capacity << "," << bytes << "," << regs << "," << ns << ",";
+		if (miss_count < 0) {
+			cout << "n/a";
+		} else {
+			cout << (double)miss_count / regs;
+		}
+		cout << (heap_bytes == empty ? "" : ",LEAK") << endl;
+	}
+}
+
+// AVLTree alone at entries customers: inserts, lookups, a print, random
+// remove + insert churn and removing everything, all in random order
+void benchAVL(int entries) {
+	mt19937 rng(entries);
+	CustomerPool pool;
+	vector<Customer*> customers;
+	for (int i = 0; i < entries; i++) {
+		Customer* customer = pool.get();
+		customer->reset(i + 1, rng() % 32768, area2);
+		customers.push_back(customer);
+	}
+	shuffle(customers.begin(), customers.end(), rng); // records of a long running restaurant are all over the pool
+	AVLTree tree(entries);
+	vector<Customer*> order = customers;
+
+	cout << "phase,entries,ops,ns_per_op,ops_per_sec,cache_misses_per_op" << endl;
+	auto report = [&](const char* phase, long long ops, double seconds, long long miss_count) {
+		cout << phase << "," << entries << "," << ops << "," << seconds * 1e9 / ops << "," << ops / seconds << ",";
+		if (miss_count < 0) {
+			cout << "n/a";
+		} else {
+			cout << (double)miss_count / ops;
+		}
+		cout << endl;
+	};
+	CacheMissCounter misses;
+
+	misses.start();
+	auto start = chrono::steady_clock::now();
+	for (Customer* customer : customers) {
+		tree.insert(customer);
+	}
+	report("insert", entries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), misses.stop());
+
+	shuffle(order.begin(), order.end(), rng);
+	long long found = 0;
+	misses.start();
+	start = chrono::steady_clock::now();
+	for (Customer* customer : order) {
+		found += tree.find(customer->result, customer->seq) == customer;
+	}
+	report("find", entries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), misses.stop());
+
+	string text;
+	misses.start();
+	start = chrono::steady_clock::now();
+	{
+		OutputSink sink([&text](const char*, size_t size) { text.resize(text.size() + size); });
+		tree.print(sink);
+	}
+	report("print", entries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), misses.stop());
+
+	misses.start();
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < entries; i++) {
+		Customer* customer = order[rng() % entries];
+		tree.remove(customer);
+		tree.insert(customer);
+	}
+	report("remove+insert", 2LL * entries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), misses.stop());
+
+	shuffle(order.begin(), order.end(), rng);
+	misses.start();
+	start = chrono::steady_clock::now();
+	for (Customer* customer : order) {
+		tree.remove(customer);
+	}
+	report("remove", entries, chrono::duration<double>(chrono::steady_clock::now() - start).count(), misses.stop());
+	if (found != entries || tree.getSize() != 0) {
+		cout << "MISMATCH" << endl;
+	}
+}
+
+// the Print output of every structure, to compare two restaurants
+string printAll(Restaurant& restaurant) {
+	string output;
+	OutputSink sink(output);
+	restaurant.setOutput(&sink);
+	restaurant.execute("PrintHT");
+	restaurant.execute("PrintAVL");
+	restaurant.execute("PrintMH");
+	restaurant.setOutput(&cout);
+	return output;
+}
+
+// ms to replay a full history, to save it as a snapshot and to restore that
+// snapshot, for a restaurant that took 2 * capacity REG/CLE commands
+void benchSnapshot(int max_capacity) {
+	string filename = "benchmark_snapshot.bin";
+	cout << "capacity,customers,commands,ms_replay,ms_save,ms_restore,bytes_per_customer" << endl;
+	for (int capacity : {1000, 10000, 100000, 1000000}) {
+		if (capacity > max_capacity) {
+			break;
+		}
+		mt19937 rng(capacity);
+		vector<string> commands;
+		for (int i = 0; i < 2 * capacity; i++) {
+			if (i < capacity || rng() % 4) {
+				commands.push_back("REG " + randomName(rng, 10));
+			} else {
+				commands.push_back("CLE " + to_string(rng() % capacity + 1));
+			}
+		}
+
+		Restaurant replayed(capacity);
+		auto start = chrono::steady_clock::now();
+		for (const string& command : commands) {
+			replayed.execute(command);
+		}
+		double ms_replay = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		bool saved = replayed.saveSnapshot(filename);
+		double ms_save = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		Restaurant restored;
+		start = chrono::steady_clock::now();
+		bool loaded = restored.loadSnapshot(filename);
+		double ms_restore = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		long long bytes = ifstream(filename, ios::binary | ios::ate).tellg();
+		int seated = 0;
+		string expected = printAll(replayed);
+		for (char x : expected) {
+			seated += x == '\n';
+		}
+		seated /= 2; // a line in PrintHT or PrintAVL and one in PrintMH per customer
+		cout << capacity << "," << seated << "," << commands.size() << "," << ms_replay << "," << ms_save << ","
+			 << ms_restore << "," << (double)bytes / max(seated, 1)
+			 << (saved && loaded && printAll(restored) == expected ? "" : ",MISMATCH") << endl;
+	}
+	remove(filename.c_str());
+}
+
+// REG/CLE history over a restaurant of capacity tables, names come back often
+vector<string> regCleHistory(mt19937& rng, int capacity, int commands) {
+	vector<string> names;
+	for (int i = 0; i < 2 * capacity; i++) {
+		names.push_back(randomName(rng, 4 + rng() % 8));
+	}
+	vector<string> history;
+	for (int i = 0; i < commands; i++) {
+		if (rng() % 5) {
+			history.push_back("REG " + names[rng() % names.size()]);
+		} else {
+			history.push_back("CLE " + to_string((int)(rng() % (capacity + 2))));
+		}
+	}
+	return history;
+}
+
+// deletes every file of a journal prefix in the current directory
+void removeJournal(string prefix) {
+	DIR* dir = opendir(".");
+	while (dirent* entry = dir ? readdir(dir) : nullptr) {
+		string name = entry->d_name;
+		if (name.compare(0, prefix.size() + 1, prefix + ".") == 0) {
+			remove(name.c_str());
+		}
+	}
+	if (dir) {
+		closedir(dir);
+	}
+}
+
+// commands/sec with the write-ahead log on, and ms to recover from its files
+// compared to replaying the whole history
+void benchWAL(int commands) {
+	int capacity = 100000;
+	string prefix = "benchmark_wal";
+	mt19937 rng(1);
+	vector<string> history = regCleHistory(rng, capacity, commands);
+	cout << "sync_every,checkpoint_every,commands,commands_per_sec,ms_recover,replayed,ms_full_replay" << endl;
+
+	Restaurant full(capacity);
+	auto start = chrono::steady_clock::now();
+	for (const string& command : history) {
+		full.execute(command);
+	}
+	double ms_full = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	string expected = printAll(full);
+
+	// intervals that do not divide commands, so recovery has a log tail to replay
+	vector<pair<int, int>> settings = {{64, 0}, {64, commands / 7}, {64, commands / 70}, {4096, commands / 7}, {1, commands / 7}};
+	for (auto [sync_every, checkpoint_every] : settings) {
+		removeJournal(prefix);
+		JournalConfig config;
+		config.log_prefix = prefix;
+		config.sync_every = sync_every;
+		config.checkpoint_every = checkpoint_every;
+		// fsync per command is slow, that setting only runs a slice of the history
+		int count = sync_every == 1 ? min(commands, 20000) : commands;
+		double seconds;
+		{
+			Restaurant restaurant(capacity);
+			Journal journal(restaurant, config);
+			journal.recover();
+			start = chrono::steady_clock::now();
+			for (int i = 0; i < count; i++) {
+				journal.execute(history[i]);
+			}
+			journal.sync();
+			seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		}
+
+		Restaurant recovered(capacity);
+		Journal journal(recovered, config);
+		start = chrono::steady_clock::now();
+		long long replayed = journal.recover();
+		double ms_recover = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		bool same = count < commands || printAll(recovered) == expected;
+		cout << sync_every << "," << checkpoint_every << "," << count << "," << count / seconds << ","
+			 << ms_recover << "," << replayed << "," << ms_full << (same ? "" : ",MISMATCH") << endl;
+	}
+	removeJournal(prefix);
+}
+
+// kills a journaled run with SIGKILL at a random moment, recovers, and checks
+// the state is the one after some prefix of the commands no shorter than what
+// the child had reported as synced
+void benchCrash(int rounds) {
+	int capacity = 64;
+	int commands = 20000;
+	string prefix = "benchmark_crash";
+	mt19937 rng(1);
+	vector<string> history = regCleHistory(rng, capacity, commands);
+	cout << "round,sync_every,checkpoint_every,kill_after_us,synced,recovered,result" << endl;
+	int failures = 0;
+	for (int round = 0; round < rounds; round++) {
+		removeJournal(prefix);
+		JournalConfig config;
+		config.log_prefix = prefix;
+		config.sync_every = 1 + rng() % 16;
+		config.checkpoint_every = 50 + rng() % 1000;
+		int kill_after = rng() % 200000;
+
+		// what the child has synced so far, shared so it survives the kill
+		atomic<long long>* progress = (atomic<long long>*)mmap(nullptr, sizeof(atomic<long long>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		new (progress) atomic<long long>(0);
+		cout.flush();
+		pid_t child = fork();
+		if (child == 0) {
+			Restaurant restaurant(capacity);
+			Journal journal(restaurant, config);
+			journal.recover();
+			for (const string& command : history) {
+				journal.execute(command);
+				progress->store(journal.getSynced());
+			}
+			journal.sync();
+			progress->store(journal.getSynced());
+			_exit(0);
+		}
+		usleep(kill_after);
+		kill(child, SIGKILL);
+		waitpid(child, nullptr, 0);
+		long long synced = progress->load();
+		munmap(progress, sizeof(atomic<long long>));
+
+		Restaurant recovered(capacity);
+		Journal journal(recovered, config);
+		journal.recover();
+		string state = printAll(recovered);
+
+		Restaurant reference(capacity);
+		int prefix_length = -1;
+		for (int k = 0; k <= commands; k++) {
+			if (k >= synced && printAll(reference) == state) {
+				prefix_length = k;
+				break;
+			}
+			if (k < commands) {
+				reference.execute(history[k]);
+			}
+		}
+		failures += prefix_length == -1;
+		cout << round << "," << config.sync_every << "," << config.checkpoint_every << "," << kill_after << ","
+			 << synced << "," << prefix_length << "," << (prefix_length == -1 ? "LOST" : "ok") << endl;
+	}
+	removeJournal(prefix);
+	cout << (failures ? "FAILED " : "passed ") << rounds - failures << "/" << rounds << endl;
+}
+
+// ops/sec of the Engine for 1, 2, 4 .. max_threads workers, every thread count
+// runs the same generated workload on fresh instances
+void benchSharded(int max_threads, int instances, int ops) {
+	vector<vector<string>> workloads;
+	for (int i = 0; i < instances; i++) {
+		WorkloadConfig config;
+		config.ops = ops;
+		config.seed = i + 1;
+		WorkloadGenerator generator(config);
+		workloads.emplace_back();
+		for (int j = 0; j < ops; j++) {
+			workloads.back().push_back(generator.next());
+		}
+	}
+
+	cout << "threads,instances,ops,seconds,ops_per_sec,speedup" << endl;
+	double base = 0;
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		Engine engine(instances, WorkloadConfig().capacity);
+		for (int i = 0; i < instances; i++) {
+			for (const string& command : workloads[i]) {
+				engine.submit(i, command);
+			}
+		}
+		auto start = chrono::steady_clock::now();
+		engine.run(threads);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (threads == 1) {
+			base = seconds;
+		}
+		long long total = (long long)instances * ops;
+		cout << threads << "," << instances << "," << total << "," << seconds << ","
+			 << total / seconds << "," << base / seconds << endl;
+	}
+}
+
+// everything f prints to cout
+string captureOutput(function<void()> f) {
+	ostringstream out;
+	streambuf* old = cout.rdbuf(out.rdbuf());
+	f();
+	cout.rdbuf(old);
+	return out.str();
+}
+
+// simulate against simulatePipelined on a file of mostly new, long names,
+// where the Huffman results are most of the work
+void benchPipeline(int max_threads, int lines) {
+	mt19937 rng(1);
+	string filename = "bench_pipeline.txt";
+	{
+		ofstream out(filename);
+		for (int i = 0; i < lines; i++) {
+			int op = rng() % 50;
+			if (op < 45) {
+				out << "REG " << randomName(rng, 16 + rng() % 48) << "\n";
+			} else if (op < 49) {
+				out << "CLE " << rng() % 1000 << "\n";
+			} else {
+				out << "PrintMH\n";
+			}
+		}
+	}
+	int capacity = 1024;
+
+	cout << "mode,threads,lines,seconds,lines_per_sec,speedup" << endl;
+	auto start = chrono::steady_clock::now();
+	string expected = captureOutput([&] { simulate(filename, capacity); });
+	double base = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "simulate,1," << lines << "," << base << "," << lines / base << ",1" << endl;
+
+	for (int threads = 1; threads <= max_threads; threads *= 2) {
+		start = chrono::steady_clock::now();
+		string output = captureOutput([&] { simulatePipelined(filename, capacity, threads); });
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		cout << "pipelined," << threads << "," << lines << "," << seconds << "," << lines / seconds << ","
+			 << base / seconds << (output == expected ? "" : ",MISMATCH") << endl;
+	}
+	remove(filename.c_str());
+}
+
+// CPU seconds the calling thread has used
+double threadCpuSeconds() {
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// REG/CLE throughput of one mutator on a restaurant of capacity tables: a
+// fill with capacity new customers, then ops workload commands. First with
+// the workload's prints run inline, then through a LiveRestaurant whose
+// prints are served from PrintViews by 0, 1, 2 .. max_readers threads, each
+// asking for a print every 200us. *_cpu is the CPU time of the mutator thread
+// alone, the wall time also holds the publisher when cores are short
+void benchLive(int max_readers, int ops, int capacity) {
+	WorkloadConfig config;
+	config.ops = ops;
+	config.capacity = capacity;
+	config.print = 0.001;
+	WorkloadGenerator generator(config);
+	mt19937 rng(capacity);
+	vector<string> fill;
+	for (int i = 0; i < capacity; i++) {
+		fill.push_back("REG " + randomName(rng, 12));
+	}
+	vector<string> commands;
+	for (int i = 0; i < ops; i++) {
+		commands.push_back(generator.next());
+	}
+	NullBuffer null_buffer;
+	ostream null_out(&null_buffer);
+
+	cout << "mode,readers,capacity,fill_seconds,fill_cpu,ops,seconds,cpu,ops_per_sec,prints,retired" << endl;
+	{
+		Restaurant restaurant(capacity, &null_out);
+		auto start = chrono::steady_clock::now();
+		double cpu_start = threadCpuSeconds();
+		for (const string& command : fill) {
+			restaurant.execute(command);
+		}
+		double fill_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double fill_cpu = threadCpuSeconds() - cpu_start;
+		long long prints = 0;
+		start = chrono::steady_clock::now();
+		cpu_start = threadCpuSeconds();
+		for (const string& command : commands) {
+			Command type = restaurant.execute(command);
+			prints += type == cmdPrintHT || type == cmdPrintAVL || type == cmdPrintMH;
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double cpu = threadCpuSeconds() - cpu_start;
+		cout << "inline,0," << capacity << "," << fill_seconds << "," << fill_cpu << "," << ops << "," << seconds << "," << cpu << ","
+			 << ops / seconds << "," << prints << ",0" << endl;
+	}
+
+	for (int readers = 0; readers <= max_readers; readers = max(2 * readers, 1)) {
+		LiveRestaurant live(capacity, max(readers, 1), 4096, &null_out);
+		atomic<bool> done(false);
+		atomic<long long> prints(0);
+		vector<thread> threads;
+		for (int reader = 0; reader < readers; reader++) {
+			threads.emplace_back([&, reader] {
+				OutputSink sink([](const char*, size_t) {});
+				Command types[] = {cmdPrintHT, cmdPrintAVL, cmdPrintMH};
+				for (int i = 0; !done; i++) {
+					live.print(reader, types[i % 3], sink);
+					prints++;
+					this_thread::sleep_for(chrono::microseconds(200));
+				}
+			});
+		}
+		auto start = chrono::steady_clock::now();
+		double cpu_start = threadCpuSeconds();
+		for (const string& command : fill) {
+			live.execute(command);
+		}
+		double fill_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double fill_cpu = threadCpuSeconds() - cpu_start;
+		start = chrono::steady_clock::now();
+		cpu_start = threadCpuSeconds();
+		for (const string& command : commands) {
+			Command type = getCommand(string_view(command).substr(0, command.find(" ")));
+			if (type != cmdPrintHT && type != cmdPrintAVL && type != cmdPrintMH) {
+				live.execute(command);
+			}
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double cpu = threadCpuSeconds() - cpu_start;
+		done = true;
+		for (thread& reader : threads) {
+			reader.join();
+		}
+
+		// once published, the readers see exactly what the restaurant prints
+		live.publish();
+		bool same = true;
+		for (Command type : {cmdPrintHT, cmdPrintAVL, cmdPrintMH}) {
+			string served, direct;
+			{
+				OutputSink sink(served);
+				live.print(0, type, sink);
+			}
+			{
+				OutputSink sink(direct);
+				live.getRestaurant().setOutput(&sink);
+				live.getRestaurant().execute(type == cmdPrintHT ? "PrintHT" : type == cmdPrintAVL ? "PrintAVL" : "PrintMH");
+			}
+			same = same && served == direct;
+		}
+		live.getRestaurant().setOutput(&null_out);
+		cout << "live," << readers << "," << capacity << "," << fill_seconds << "," << fill_cpu << "," << ops << "," << seconds << "," << cpu << "," << ops / seconds << ","
+			 << prints << "," << live.getRetired() << (same ? "" : ",MISMATCH") << endl;
+	}
+}
+
+// one load generator connection to a CommandServer: keeps depth commands in
+// flight and records the latency of each answer
+class ServerClient {
+private:
+	int fd;
+	string buffer;
+	bool line_start; // the last byte read ended a line
+public:
+	string answers; // everything but the empty lines ending the answers, if kept
+	bool keep = false;
+	vector<long long> latencies; // ns
+
+	ServerClient(string path) {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, path.data(), min(path.size(), sizeof(address.sun_path) - 1));
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+			::close(fd);
+			fd = -1;
+		}
+		line_start = true;
+	}
+	~ServerClient() {
+		if (fd >= 0) {
+			::close(fd);
+		}
+	}
+
+	bool isOk() {
+		return fd >= 0;
+	}
+
+	// false if the server went away
+	bool run(const vector<string>& commands, int depth) {
+		deque<chrono::steady_clock::time_point> sent;
+		size_t next = 0;
+		char data[1 << 16];
+		while (next < commands.size() || !sent.empty()) {
+			buffer.clear();
+			while (next < commands.size() && (int)sent.size() < depth) {
+				buffer += commands[next++];
+				buffer += '\n';
+				sent.push_back(chrono::steady_clock::now());
+			}
+			for (size_t done = 0; done < buffer.size(); ) {
+				ssize_t wrote = ::send(fd, buffer.data() + done, buffer.size() - done, MSG_NOSIGNAL);
+				if (wrote <= 0) {
+					return false;
+				}
+				done += wrote;
+			}
+			ssize_t got = ::read(fd, data, sizeof(data));
+			if (got <= 0) {
+				return false;
+			}
+			auto now = chrono::steady_clock::now();
+			for (ssize_t i = 0; i < got; i++) {
+				if (data[i] == '\n' && line_start) {
+					latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(now - sent.front()).count());
+					sent.pop_front();
+				} else if (keep) {
+					answers += data[i];
+				}
+				line_start = data[i] == '\n';
+			}
+		}
+		return true;
+	}
+};
+
+// clients connections of depth commands in flight each against one server
+// thread; answers of a single client are checked against a plain Restaurant
+void benchServer(int max_clients, int ops, int depth) {
+	string path = "/tmp/restaurant_bench.sock";
+	WorkloadConfig config;
+	config.ops = ops;
+	config.print = 0.001;
+
+	cout << "clients,depth,ops,seconds,ops_per_sec,p50_us,p99_us,p999_us,ops_per_batch" << endl;
+	for (int clients = 1; clients <= max_clients; clients *= 2) {
+		vector<vector<string>> workloads(clients);
+		for (int i = 0; i < clients; i++) {
+			config.seed = i + 1;
+			WorkloadGenerator generator(config);
+			for (int j = 0; j < ops; j++) {
+				workloads[i].push_back(generator.next());
+			}
+		}
+		CommandServer server(path, config.capacity);
+		if (!server.listen()) {
+			cout << "can't listen on " << path << endl;
+			return;
+		}
+		thread serving(&CommandServer::run, &server);
+		vector<ServerClient*> connections;
+		for (int i = 0; i < clients; i++) {
+			connections.push_back(new ServerClient(path));
+			connections.back()->keep = clients == 1;
+		}
+		atomic<bool> ok(true);
+		vector<thread> threads;
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < clients; i++) {
+			threads.emplace_back([&, i] {
+				if (!connections[i]->isOk() || !connections[i]->run(workloads[i], depth)) {
+					ok = false;
+				}
+			});
+		}
+		for (thread& client : threads) {
+			client.join();
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		server.stop();
+		serving.join();
+
+		vector<long long> latencies;
+		for (ServerClient* connection : connections) {
+			latencies.insert(latencies.end(), connection->latencies.begin(), connection->latencies.end());
+		}
+		sort(latencies.begin(), latencies.end());
+		bool same = ok;
+		if (clients == 1) {
+			string expected;
+			{
+				OutputSink sink(expected);
+				Restaurant restaurant(config.capacity, &sink);
+				for (const string& command : workloads[0]) {
+					restaurant.execute(command);
+				}
+			}
+			same = same && connections[0]->answers == expected;
+		}
+		for (ServerClient* connection : connections) {
+			delete connection;
+		}
+		long long total = (long long)clients * ops;
+		cout << clients << "," << depth << "," << total << "," << seconds << "," << total / seconds << ","
+			 << percentile(latencies, 0.5) / 1e3 << "," << percentile(latencies, 0.99) / 1e3 << ","
+			 << percentile(latencies, 0.999) / 1e3 << "," << (double)server.getCommands() / max(server.getBatches(), 1LL)
+			 << (same ? "" : ",MISMATCH") << endl;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	string mode = argc > 1 ? argv[1] : "capacity";
+	if (mode == "capacity") {
+		benchCapacity(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "huffman") {
+		benchHuffman(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "lru") {
+		benchLRU(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "hash") {
+		benchHash(argc > 2 ? stoi(argv[2]) : 16384);
+	} else if (mode == "ingest") {
+		benchIngest(argc > 2 ? stoi(argv[2]) : 5000000);
+	} else if (mode == "wipe") {
+		benchWipe(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "print") {
+		benchPrint(argc > 2 ? stoi(argv[2]) : 1000000, argc > 3 ? stoi(argv[3]) : 5);
+	} else if (mode == "customer") {
+		benchCustomer(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "avl") {
+		benchAVL(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "snapshot") {
+		benchSnapshot(argc > 2 ? stoi(argv[2]) : 1000000);
+	} else if (mode == "wal") {
+		benchWAL(argc > 2 ? stoi(argv[2]) : 2000000);
+	} else if (mode == "crash") {
+		benchCrash(argc > 2 ? stoi(argv[2]) : 50);
+	} else if (mode == "sharded") {
+		benchSharded(argc > 2 ? stoi(argv[2]) : 64, argc > 3 ? stoi(argv[3]) : 256, argc > 4 ? stoi(argv[4]) : 20000);
+	} else if (mode == "pipeline") {
+		benchPipeline(argc > 2 ? stoi(argv[2]) : 8, argc > 3 ? stoi(argv[3]) : 1000000);
+	} else if (mode == "live") {
+		benchLive(argc > 2 ? stoi(argv[2]) : 4, argc > 3 ? stoi(argv[3]) : 2000000, argc > 4 ? stoi(argv[4]) : 1000000);
+	} else if (mode == "server") {
+		benchServer(argc > 2 ? stoi(argv[2]) : 16, argc > 3 ? stoi(argv[3]) : 100000, argc > 4 ? stoi(argv[4]) : 16);
+	} else if (mode == "workload") {
+		WorkloadConfig config;
+		if (!config.parse(argc, argv, 2)) {
+			cout << "unknown workload option" << endl;
+			return 1;
+		}
+		benchWorkload(config);
+	} else if (mode == "huffman-codec") {
+		benchHuffmanCodec(argc > 2 ? stoi(argv[2]) : 64 << 20);
+	} else if (mode == "huffman-build") {
+		benchHuffmanBuild(argc > 2 ? stoi(argv[2]) : 1 << 20);
+	} else {
+		cout << "unknown benchmark " << mode << endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -2,8 +2,26 @@
 #define MAIN_H
 #include<bits/stdc++.h> 
 #include<string>
+#include<dirent.h>
+#include<fcntl.h>
+#include<sys/epoll.h>
+#include<sys/eventfd.h>
+#include<sys/mman.h>
+#include<sys/socket.h>
+#include<sys/stat.h>
+#include<sys/un.h>
+#include<unistd.h>
 
 using namespace std;
 #define MAXSIZE 32
 
+// per-command latency stats in Restaurant, build with -DRESTAURANT_STATS=0 to drop them
+#ifndef RESTAURANT_STATS
+#define RESTAURANT_STATS 1
+#endif
+// every REG is counted but only 1 in RESTAURANT_STATS_SAMPLE is timed, CLE and Print* always are
+#ifndef RESTAURANT_STATS_SAMPLE
+#define RESTAURANT_STATS_SAMPLE 8
+#endif
+
 #endif
\ No newline at end of file
@@ -162,7 +162,555 @@ string getHuffString(string text) {
 	return Huff_string;
 }
 
-bool checkName(string name) {
+void encodeHuffCodes(HuffNode<char>* node, unsigned long long code, int length, unsigned long long codes[], int lengths[]) {
+	if (!node) {
+		return;
+	}
+
+	if (node->isLeaf()) {
+		unsigned char x = static_cast<LeafNode<char>*>(node)->data();
+		codes[x] = code;
+		lengths[x] = length;
+	} else {
+		encodeHuffCodes(static_cast<IntlNode<char>*>(node)->getLeft(), code << 1, length + 1, codes, lengths);
+		encodeHuffCodes(static_cast<IntlNode<char>*>(node)->getRight(), (code << 1) | 1, length + 1, codes, lengths);
+	}
+}
+
+// same as convertBinToDec of the last 15 bits of getHuffString(text),
+// the codes are kept as integers so no bit string is built
+int getHuffResult(const string& text) {
+	HuffTree<char>* tree = buildHuffTree(text);
+	unsigned long long codes[256];
+	int lengths[256];
+
+	encodeHuffCodes(tree->root(), 0, 0, codes, lengths);
+	if (tree->isLeaf()) {
+		unsigned char x = static_cast<LeafNode<char>*>(tree->root())->data();
+		codes[x] = 1;
+		lengths[x] = 1;
+	}
+	delete tree;
+
+	int result = 0;
+	for (char x : text) {
+		int length = min(lengths[(unsigned char)x], 15);
+		int code = codes[(unsigned char)x] & ((1 << length) - 1);
+		result = ((result << length) | code) & 0x7FFF;
+	}
+	return result;
+}
+
+// Huffman tree in a flat node array: children are indices, nothing is virtual
+// and the arrays are reused, so building a tree allocates nothing once warm
+class HuffArena {
+private:
+	class Node {
+	public:
+		int freq;
+		int order; // creation order, breaks ties between equal freq like Compare
+		int left;  // -1 for a leaf
+		int right;
+		char data;
+		unsigned long long code; // filled in by encode
+		int length;
+	};
+	vector<Node> nodes;
+	vector<int> freq_queue;
+	bool two_queue;
+	unsigned long long codes[256];
+	int lengths[256];
+
+	// true if a comes out of the queue after b, same rule as Compare<char>
+	bool after(int a, int b) {
+		const Node& x = nodes[a];
+		const Node& y = nodes[b];
+		if (x.freq == y.freq) {
+			if (x.left == -1 && y.left == -1) {
+				return x.data > y.data;
+			} else {
+				return x.order > y.order;
+			}
+		} else {
+			return x.freq > y.freq;
+		}
+	}
+
+	int newNode(int freq, int left, int right, char data) {
+		Node node;
+		node.freq = freq;
+		node.order = nodes.size();
+		node.left = left;
+		node.right = right;
+		node.data = data;
+		nodes.push_back(node);
+		return nodes.size() - 1;
+	}
+
+	void push(int index) {
+		freq_queue.push_back(index);
+		push_heap(freq_queue.begin(), freq_queue.end(), [this](int a, int b) { return after(a, b); });
+	}
+
+	int pop() {
+		pop_heap(freq_queue.begin(), freq_queue.end(), [this](int a, int b) { return after(a, b); });
+		int index = freq_queue.back();
+		freq_queue.pop_back();
+		return index;
+	}
+
+	int buildHeap(int freq[]) {
+		freq_queue.clear();
+		for (int i = 0; i < 256; i++) {
+			if (freq[i] > 0) {
+				push(newNode(freq[i], -1, -1, (char)i));
+			}
+		}
+		while (freq_queue.size() > 1) {
+			int left = pop();
+			int right = pop();
+			push(newNode(nodes[left].freq + nodes[right].freq, left, right, 0));
+		}
+		return freq_queue.empty() ? -1 : freq_queue[0];
+	}
+
+	// leaves sorted by (freq, data) in nodes[0, leaf_count) and the internal nodes
+	// after them are the two queues. Internal nodes are created with non-decreasing
+	// freq so both stay sorted, and on equal freq the leaf goes first like Compare
+	int buildTwoQueue(int freq[]) {
+		for (int i = 0; i < 256; i++) {
+			if (freq[i] > 0) {
+				newNode(freq[i], -1, -1, (char)i);
+			}
+		}
+		int leaf_count = nodes.size();
+		if (leaf_count == 0) {
+			return -1;
+		}
+		sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) {
+			return a.freq < b.freq || (a.freq == b.freq && a.data < b.data);
+		});
+		for (int i = 0; i < leaf_count; i++) {
+			nodes[i].order = i;
+		}
+
+		int leaf = 0;
+		int intl = leaf_count;
+		auto take = [&]() {
+			if (leaf < leaf_count && (intl == (int)nodes.size() || nodes[leaf].freq <= nodes[intl].freq)) {
+				return leaf++;
+			}
+			return intl++;
+		};
+		while ((leaf_count - leaf) + ((int)nodes.size() - intl) > 1) {
+			int left = take();
+			int right = take();
+			newNode(nodes[left].freq + nodes[right].freq, left, right, 0);
+		}
+		return nodes.size() - 1;
+	}
+public:
+	// two_queue = false merges through a binary heap like buildHuffTree
+	HuffArena(bool two_queue = true) {
+		this->two_queue = two_queue;
+		nodes.reserve(511);
+		freq_queue.reserve(256);
+	}
+
+	// builds the tree of text and returns the root index
+	int build(string_view text) {
+		int freq[256] = {0};
+		for (char x : text) {
+			freq[(unsigned char)x]++;
+		}
+		nodes.clear();
+		if (two_queue) {
+			return buildTwoQueue(freq);
+		}
+		return buildHeap(freq);
+	}
+
+	// codes of the last built tree, parents are always created after their children
+	// so one pass from the root down reaches every node after its parent
+	void encode(int root) {
+		if (nodes[root].left == -1) { // a single leaf gets code "1"
+			codes[(unsigned char)nodes[root].data] = 1;
+			lengths[(unsigned char)nodes[root].data] = 1;
+			return;
+		}
+		nodes[root].code = 0;
+		nodes[root].length = 0;
+		for (int i = root; i >= 0; i--) {
+			Node& node = nodes[i];
+			if (node.left == -1) {
+				codes[(unsigned char)node.data] = node.code;
+				lengths[(unsigned char)node.data] = node.length;
+				continue;
+			}
+			nodes[node.left].code = node.code << 1;
+			nodes[node.left].length = node.length + 1;
+			nodes[node.right].code = (node.code << 1) | 1;
+			nodes[node.right].length = node.length + 1;
+		}
+	}
+
+	// code length of every byte value of a histogram, 0 for the ones with freq 0
+	void getLengths(int freq[], int out[]) {
+		nodes.clear();
+		int root = two_queue ? buildTwoQueue(freq) : buildHeap(freq);
+		fill(out, out + 256, 0);
+		if (root == -1) {
+			return;
+		}
+		encode(root);
+		for (int i = 0; i < 256; i++) {
+			if (freq[i] > 0) {
+				out[i] = lengths[i];
+			}
+		}
+	}
+
+	// same value as getHuffResult
+	int getResult(string_view text) {
+		int root = build(text);
+		if (root == -1) {
+			return 0;
+		}
+		encode(root);
+		int result = 0;
+		for (char x : text) {
+			int length = min(lengths[(unsigned char)x], 15);
+			int code = codes[(unsigned char)x] & ((1 << length) - 1);
+			result = ((result << length) | code) & 0x7FFF;
+		}
+		return result;
+	}
+};
+
+// name -> result cache for returning customers, direct mapped so a colliding
+// name replaces the old entry and the memory stays fixed
+class HuffCache {
+private:
+	class Entry {
+	public:
+		string name;
+		int result;
+		bool used;
+		Entry() {
+			result = 0;
+			used = false;
+		}
+	};
+	vector<Entry> entries;
+	size_t mask;
+	HuffArena arena;
+	long long hits;
+	long long misses;
+public:
+	HuffCache(int size = 1024) {
+		size_t entry_count = 1;
+		while (entry_count < (size_t)size) {
+			entry_count <<= 1;
+		}
+		entries.resize(entry_count);
+		mask = entry_count - 1;
+		hits = 0;
+		misses = 0;
+	}
+
+	int getResult(string_view name) {
+		Entry& entry = entries[hash<string_view>()(name) & mask];
+		if (entry.used && entry.name == name) {
+			hits++;
+			return entry.result;
+		}
+		misses++;
+		entry.name = name;
+		entry.result = arena.getResult(name);
+		entry.used = true;
+		return entry.result;
+	}
+
+	long long getHits() {
+		return hits;
+	}
+	long long getMisses() {
+		return misses;
+	}
+};
+
+// a byte buffer after HuffCodec::encode. Bits are packed LSB first and every
+// code goes in with its first bit lowest, the same order DEFLATE uses
+class HuffEncoded {
+public:
+	uint8_t lengths[256]; // canonical code length of every byte value, 0 = absent
+	vector<uint8_t> bits;
+	size_t size; // bytes of input
+	uint64_t bit_count;
+};
+
+// Huffman codec for byte buffers on top of HuffArena. Code lengths are cut to
+// MAX_LENGTH and the codes are canonical, so the lengths alone define the code
+class HuffCodec {
+public:
+	static const int MAX_LENGTH = 16;
+private:
+	// decode table entry: length in bits 0-7 (0 = no such code), byte in bits
+	// 8-15. Codes longer than PRIMARY_BITS link to a subtable of the last
+	// MAX_LENGTH - PRIMARY_BITS bits, its offset is in bits 17 and up
+	static const int PRIMARY_BITS = 11;
+	static const int SUB_BITS = MAX_LENGTH - PRIMARY_BITS;
+	static const uint32_t LINK = 1 << 16;
+
+	HuffArena arena;
+	uint32_t codes[256];
+	vector<uint32_t> table;
+	// by the next PRIMARY_BITS bits: both bytes when two codes fit in them.
+	// Length in bits 0-7, bytes in 8-15 and 16-23, how many in 24-25; 0 means
+	// the code is longer than PRIMARY_BITS (or invalid) and table has it
+	vector<uint32_t> pairs;
+
+	bool buildTable(const uint8_t lengths[]) {
+		if (!canonicalCodes(lengths, codes)) {
+			return false;
+		}
+		table.assign(1 << PRIMARY_BITS, 0);
+		for (int x = 0; x < 256; x++) {
+			int length = lengths[x];
+			if (length == 0) {
+				continue;
+			}
+			uint32_t entry = (x << 8) | length;
+			if (length <= PRIMARY_BITS) {
+				// every index whose low bits are the code
+				for (uint32_t i = codes[x]; i < (1u << PRIMARY_BITS); i += 1 << length) {
+					table[i] = entry;
+				}
+				continue;
+			}
+			uint32_t primary = codes[x] & ((1 << PRIMARY_BITS) - 1);
+			if (!(table[primary] & LINK)) {
+				table[primary] = LINK | (table.size() << 17);
+				table.resize(table.size() + (1 << SUB_BITS), 0);
+			}
+			uint32_t offset = table[primary] >> 17;
+			for (uint32_t i = codes[x] >> PRIMARY_BITS; i < (1u << SUB_BITS); i += 1 << (length - PRIMARY_BITS)) {
+				table[offset + i] = entry;
+			}
+		}
+		pairs.assign(1 << PRIMARY_BITS, 0);
+		for (uint32_t i = 0; i < (1u << PRIMARY_BITS); i++) {
+			uint32_t first = table[i];
+			int length = first & 0xFF;
+			if ((first & LINK) || length == 0) {
+				continue;
+			}
+			pairs[i] = (1 << 24) | (first & 0xFFFF);
+			// the bits left over are the start of the next code, padded with zeros
+			uint32_t second = table[i >> length];
+			int rest = second & 0xFF;
+			if (!(second & LINK) && rest > 0 && length + rest <= PRIMARY_BITS) {
+				pairs[i] = (2 << 24) | ((second & 0xFF00) << 8) | (first & 0xFF00) | (length + rest);
+			}
+		}
+		return true;
+	}
+
+	// the entry of the code in the low bits of buffer
+	uint32_t lookup(uint64_t buffer) {
+		uint32_t entry = table[buffer & ((1 << PRIMARY_BITS) - 1)];
+		if (entry & LINK) {
+			entry = table[(entry >> 17) + ((buffer >> PRIMARY_BITS) & ((1 << SUB_BITS) - 1))];
+		}
+		return entry;
+	}
+
+	static uint32_t reverse(uint32_t code, int length) {
+		uint32_t reversed = 0;
+		for (int i = 0; i < length; i++) {
+			reversed = (reversed << 1) | ((code >> i) & 1);
+		}
+		return reversed;
+	}
+
+	// moves leaves deeper than MAX_LENGTH up, the count-per-length adjustment
+	// of JPEG (Annex K.3); the shortest lengths go to the shortest codes of before
+	static void limitLengths(int lengths[]) {
+		int count[257] = {0};
+		int longest = 0;
+		for (int i = 0; i < 256; i++) {
+			count[lengths[i]]++;
+			longest = max(longest, lengths[i]);
+		}
+		if (longest <= MAX_LENGTH) {
+			return;
+		}
+		for (int i = longest; i > MAX_LENGTH; i--) {
+			while (count[i] > 0) {
+				int j = i - 2;
+				while (count[j] == 0) {
+					j--;
+				}
+				count[i] -= 2;
+				count[i - 1]++;
+				count[j + 1] += 2;
+				count[j]--;
+			}
+		}
+		vector<int> order;
+		for (int i = 0; i < 256; i++) {
+			if (lengths[i] > 0) {
+				order.push_back(i);
+			}
+		}
+		stable_sort(order.begin(), order.end(), [&](int a, int b) { return lengths[a] < lengths[b]; });
+		int length = 1;
+		for (int x : order) {
+			while (count[length] == 0) {
+				length++;
+			}
+			lengths[x] = length;
+			count[length]--;
+		}
+	}
+public:
+	// canonical codes of lengths, bit reversed so they are written LSB first.
+	// false if the lengths are not a prefix code of at most MAX_LENGTH bits
+	static bool canonicalCodes(const uint8_t lengths[], uint32_t codes[]) {
+		int count[MAX_LENGTH + 1] = {0};
+		for (int i = 0; i < 256; i++) {
+			if (lengths[i] > MAX_LENGTH) {
+				return false;
+			}
+			count[lengths[i]]++;
+		}
+		count[0] = 0;
+		uint32_t next[MAX_LENGTH + 2];
+		uint32_t code = 0;
+		long long room = 1;
+		for (int length = 1; length <= MAX_LENGTH; length++) {
+			room = 2 * room - count[length];
+			if (room < 0) {
+				return false;
+			}
+			code = (code + count[length - 1]) << 1;
+			next[length] = code;
+		}
+		for (int i = 0; i < 256; i++) {
+			codes[i] = lengths[i] ? reverse(next[lengths[i]]++, lengths[i]) : 0;
+		}
+		return true;
+	}
+
+	void encode(string_view input, HuffEncoded& out) {
+		int freq[256] = {0};
+		for (char x : input) {
+			freq[(unsigned char)x]++;
+		}
+		int lengths[256];
+		arena.getLengths(freq, lengths);
+		limitLengths(lengths);
+		uint64_t bit_count = 0;
+		for (int i = 0; i < 256; i++) {
+			out.lengths[i] = lengths[i];
+			bit_count += (uint64_t)freq[i] * lengths[i];
+		}
+		canonicalCodes(out.lengths, codes);
+		out.size = input.size();
+		out.bit_count = bit_count;
+		out.bits.assign((bit_count + 7) / 8 + 8, 0); // 8 bytes of slack for the last 64 bit store
+
+		// 3 codes of up to 16 bits go into the buffer between two stores, a
+		// store writes all 8 bytes and moves on by the whole bytes in it
+		uint8_t* dst = out.bits.data();
+		uint64_t buffer = 0;
+		int count = 0;
+		const uint8_t* src = (const uint8_t*)input.data();
+		const uint8_t* end = src + input.size();
+		while (end - src >= 3) {
+			buffer |= (uint64_t)codes[src[0]] << count;
+			count += out.lengths[src[0]];
+			buffer |= (uint64_t)codes[src[1]] << count;
+			count += out.lengths[src[1]];
+			buffer |= (uint64_t)codes[src[2]] << count;
+			count += out.lengths[src[2]];
+			src += 3;
+			memcpy(dst, &buffer, 8); // little endian: the lowest bits go first
+			dst += count >> 3;
+			buffer >>= count & ~7;
+			count &= 7;
+		}
+		for (; src < end; src++) {
+			buffer |= (uint64_t)codes[*src] << count;
+			count += out.lengths[*src];
+		}
+		memcpy(dst, &buffer, 8);
+		out.bits.resize((bit_count + 7) / 8);
+	}
+
+	// inverse of encode, one or two table probes per byte. false if the bits
+	// are not a valid code of the lengths or end too early
+	bool decode(const HuffEncoded& in, string& out) {
+		out.resize(in.size);
+		if (in.size == 0) {
+			return true;
+		}
+		if (!buildTable(in.lengths)) {
+			return false;
+		}
+		char* dst = &out[0];
+		size_t produced = 0;
+		const uint8_t* src = in.bits.data();
+		const uint8_t* end = src + in.bits.size();
+		uint64_t buffer = 0;
+		int count = 0;
+
+		// refill to 56 or more bits with one unaligned load, then 3 probes of
+		// up to 16 bits that give 1 or 2 bytes each. Bits past count are real
+		// input already, the next load ORs the same bits in
+		while (in.size - produced >= 6 && end - src >= 8) {
+			uint64_t word;
+			memcpy(&word, src, 8);
+			buffer |= word << count;
+			src += (63 - count) >> 3;
+			count |= 56;
+			for (int k = 0; k < 3; k++) {
+				uint32_t entry = pairs[buffer & ((1 << PRIMARY_BITS) - 1)];
+				if (entry == 0) {
+					entry = lookup(buffer);
+					if (entry == 0) {
+						return false;
+					}
+					entry = (1 << 24) | (entry & 0xFFFF);
+				}
+				int length = entry & 0xFF;
+				dst[produced] = entry >> 8;
+				dst[produced + 1] = entry >> 16;
+				produced += entry >> 24;
+				buffer >>= length;
+				count -= length;
+			}
+		}
+		// the last bytes of input, loaded one at a time
+		while (produced < in.size) {
+			while (count <= 56 && src < end) {
+				buffer |= (uint64_t)*src++ << count;
+				count += 8;
+			}
+			uint32_t entry = lookup(buffer);
+			int length = entry & 0xFF;
+			if (length == 0 || length > count) {
+				return false;
+			}
+			dst[produced++] = entry >> 8;
+			buffer >>= length;
+			count -= length;
+		}
+		return true;
+	}
+};
+
+bool checkName(string_view name) {
 	for (char x : name) {
 		if (!isalpha(x)) {
 			return false;
@@ -171,7 +719,7 @@ bool checkName(string name) {
 	return true;
 }
 
-bool checkID(string ID) {
+bool checkID(string_view ID) {
 	if (ID[0] != '-' && !isdigit(ID[0])) {
 		return false;
 	}
@@ -193,945 +741,3406 @@ int convertBinToDec(string bin) {
 	return dec;
 }
 
-class HashTable {
+// where the Print commands write. Lines are formatted into a reusable buffer
+// and handed to the target in large writes, either when the buffer fills up or
+// on flush(). The target is an ostream, a file descriptor, a string in memory
+// or any callback
+class OutputSink {
+private:
+	static const size_t BUFFER_SIZE = 1 << 16;
+	char* buffer;
+	size_t used;
+	function<void(const char*, size_t)> target;
+public:
+	OutputSink(function<void(const char*, size_t)> target) {
+		buffer = new char[BUFFER_SIZE];
+		used = 0;
+		this->target = target;
+	}
+	// flush() also flushes out, so nothing is left in either buffer
+	OutputSink(ostream& out) : OutputSink([&out](const char* data, size_t size) {
+		out.write(data, size);
+		out.flush();
+	}) {}
+	OutputSink(string& memory) : OutputSink([&memory](const char* data, size_t size) {
+		memory.append(data, size);
+	}) {}
+	// the fd is not closed by the sink
+	OutputSink(int fd) : OutputSink([fd](const char* data, size_t size) {
+		while (size > 0) {
+			ssize_t written = ::write(fd, data, size);
+			if (written <= 0) {
+				return;
+			}
+			data += written;
+			size -= written;
+		}
+	}) {}
+	~OutputSink() {
+		flush();
+		delete[] buffer;
+	}
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+	void flush() {
+		if (used > 0) {
+			target(buffer, used);
+			used = 0;
+		}
+	}
+
+	void put(char x) {
+		if (used == BUFFER_SIZE) {
+			flush();
+		}
+		buffer[used++] = x;
+	}
+
+	void write(string_view text) {
+		if (used + text.size() > BUFFER_SIZE) {
+			flush();
+			if (text.size() > BUFFER_SIZE) {
+				target(text.data(), text.size());
+				return;
+			}
+		}
+		memcpy(buffer + used, text.data(), text.size());
+		used += text.size();
+	}
+
+	void write(long long value) {
+		if (used + 20 > BUFFER_SIZE) {
+			flush();
+		}
+		used = to_chars(buffer + used, buffer + BUFFER_SIZE, value).ptr - buffer;
+	}
+
+	// "a-b-c\n", the line every Print command is made of
+	void writeLine(long long a, long long b) {
+		write(a);
+		put('-');
+		write(b);
+		put('\n');
+	}
+	void writeLine(long long a, long long b, long long c) {
+		write(a);
+		put('-');
+		write(b);
+		put('-');
+		write(c);
+		put('\n');
+	}
+};
+
+// one bit per slot, set = taken. A second level has one bit per word that is
+// set when all 64 slots of the word are taken, so looking for the next free
+// slot past a long run of taken ones skips 4096 slots per step
+class SlotBitmap {
+private:
+	int count;
+	vector<unsigned long long> taken;
+	vector<unsigned long long> full;
+
+	void setFull(int word, bool value) {
+		if (value) {
+			full[word >> 6] |= 1ULL << (word & 63);
+		} else {
+			full[word >> 6] &= ~(1ULL << (word & 63));
+		}
+	}
+
+	// first word in [from, to) with a free slot, -1 if none
+	int nextOpenWord(int from, int to) {
+		while (from < to) {
+			unsigned long long open = ~full[from >> 6] & (~0ULL << (from & 63));
+			if (open) {
+				int word = ((from >> 6) << 6) + __builtin_ctzll(open);
+				return word < to ? word : -1;
+			}
+			from = ((from >> 6) + 1) << 6;
+		}
+		return -1;
+	}
+public:
+	SlotBitmap(int count = 0) {
+		reset(count);
+	}
+
+	// all slots free, the bits past the last slot stay set so they are never picked
+	void reset(int count) {
+		this->count = count;
+		int words = (count + 63) / 64;
+		taken.assign(words, 0);
+		full.assign((words + 63) / 64, 0);
+		if (count & 63) {
+			taken.back() = ~0ULL << (count & 63);
+		}
+		if (words & 63) {
+			full.back() = ~0ULL << (words & 63);
+		}
+	}
+
+	void set(int slot, bool value) {
+		int word = slot >> 6;
+		if (value) {
+			taken[word] |= 1ULL << (slot & 63);
+		} else {
+			taken[word] &= ~(1ULL << (slot & 63));
+		}
+		setFull(word, taken[word] == ~0ULL);
+	}
+
+	// first free slot at or after start, wrapping around, -1 if all are taken.
+	// Same slot as stepping one slot at a time from start
+	int nextFree(int start) {
+		if (count == 0) {
+			return -1;
+		}
+		int word = start >> 6;
+		unsigned long long free_bits = ~taken[word] & (~0ULL << (start & 63));
+		if (free_bits) {
+			return (word << 6) + __builtin_ctzll(free_bits);
+		}
+		int next = nextOpenWord(word + 1, taken.size());
+		if (next == -1) {
+			next = nextOpenWord(0, word + 1);
+		}
+		if (next == -1) {
+			return -1;
+		}
+		return (next << 6) + __builtin_ctzll(~taken[next]);
+	}
+};
+
+class Customer;
+
+// links of a Customer in one doubly linked order
+class ListHook {
+public:
+	Customer* prev;
+	Customer* next;
+};
+
+// one record per seated customer. Every structure links the record through its
+// own hook instead of keeping a node of its own, so the name and num exist once
+class Customer {
+public:
+	int ID;
+	int result;
+	int num; // so lan goi mon
+	Area area;
+	uint32_t name; // symbol, the text is in CustomerIndex
+	ListHook fifo;
+	ListHook lrco;
+	ListHook area_list; // customers of the same area in FIFO order
+	int pos; // index in the LFCO heap
+	int priority; // LFCO tie break, order of arrival
+	int slot; // index in the area 1 table
+	uint32_t node; // index in the area 2 tree
+	long long seq; // area 2 key is (result, seq)
+
+	Customer() {
+		reset(0, 0, area1);
+	}
+
+	// a fresh record, unlinked from everything
+	void reset(int ID, int result, Area area) {
+		this->ID = ID;
+		this->result = result;
+		this->num = 1;
+		this->area = area;
+		this->name = 0;
+		fifo.prev = fifo.next = nullptr;
+		lrco.prev = lrco.next = nullptr;
+		area_list.prev = area_list.next = nullptr;
+		pos = -1;
+		priority = 0;
+		slot = -1;
+		node = ~0U;
+		seq = -1;
+	}
+};
+
+// Customer records handed out from slabs, a released record goes on a free
+// list and is the next one handed out
+class CustomerPool {
 private:
-	class HashNode {
+	vector<Customer*> slabs;
+	int slab_size;
+	int used; // records of the last slab handed out so far
+	Customer* free_list; // linked through fifo.next
+public:
+	CustomerPool(int slab_size = 1024) {
+		this->slab_size = max(slab_size, 1);
+		used = this->slab_size;
+		free_list = nullptr;
+	}
+	~CustomerPool() {
+		for (Customer* slab : slabs) {
+			delete[] slab;
+		}
+	}
+	CustomerPool(const CustomerPool&) = delete;
+	CustomerPool& operator=(const CustomerPool&) = delete;
+
+	Customer* get() {
+		if (free_list != nullptr) {
+			Customer* customer = free_list;
+			free_list = customer->fifo.next;
+			return customer;
+		}
+		if (used == slab_size) {
+			slabs.push_back(new Customer[slab_size]);
+			used = 0;
+		}
+		return &slabs.back()[used++];
+	}
+
+	void release(Customer* customer) {
+		customer->fifo.next = free_list;
+		free_list = customer;
+	}
+};
+
+// open addressing on result. The default is linear probing on
+// result % max_size: a removed slot becomes a tombstone that the next insert
+// may take, which keeps the slot order (the PrintHT output) of the reference
+// table. robin_hood = true uses Robin Hood probing over 2 * max_size slots
+// with backward-shift deletion instead, so PrintHT order differs in that mode.
+// Every customer knows its slot, so it is removed without probing.
+class HashTable {
+public:
+	class ProbeStats {
 	public:
-		int ID;
-		int result;
-		string name;
-		int num; // so lan goi mon
-		HashNode(int ID = 0, int result = 0, string name = "", int num = 0) {
-			this->ID = ID;
-			this->result = result;
-			this->name = name;
-			this->num = num;
-		}
-		~HashNode() {}
+		int entries;
+		double average; // probes for a successful lookup, 1 = found at home slot
+		int max;
 	};
-	int size; // max = MAXSIZE/2
-	const int max_size = MAXSIZE / 2;
-	vector<HashNode*> table;
-public:
-	bool isFull() {
-		return size >= max_size;
+private:
+	int size; // max = capacity/2
+	int max_size;
+	int slot_count;
+	bool robin_hood;
+	vector<Customer*> table;
+	vector<bool> deleted; // tombstones, linear probing only
+	SlotBitmap used; // slot holds a customer, linear probing only
+
+	int home(int result, int ID) {
+		if (!robin_hood) {
+			return hash_function(result);
+		}
+		// spread the 15 bit results over the whole table
+		unsigned long long key = ((unsigned long long)(unsigned int)result << 32) | (unsigned int)ID;
+		key *= 0x9E3779B97F4A7C15ULL;
+		return (key >> 32) % slot_count;
 	}
-	HashTable() {
-		size = 0;
-		table.resize(max_size, nullptr);
+
+	int distance(int from, int to) {
+		return (to - from + slot_count) % slot_count;
 	}
-	~HashTable() {
-		clear();
+
+	void place(Customer* customer, int slot) {
+		table[slot] = customer;
+		customer->slot = slot;
 	}
-	int hash_function(int result) {
-		return result % max_size;
+
+	// the first empty or tombstone slot from home, same slot the reference
+	// insert reaches by stepping one slot at a time
+	void insertLinear(Customer* customer) {
+		int slot = used.nextFree(hash_function(customer->result));
+		place(customer, slot);
+		deleted[slot] = false;
+		used.set(slot, true);
+	}
+
+	void removeLinear(int slot) {
+		table[slot] = nullptr;
+		deleted[slot] = true;
+		used.set(slot, false);
+		// tombstones right before an empty slot are not on any probe path
+		if (table[(slot + 1) % slot_count] == nullptr && !deleted[(slot + 1) % slot_count]) {
+			while (table[slot] == nullptr && deleted[slot]) {
+				deleted[slot] = false;
+				slot = (slot - 1 + slot_count) % slot_count;
+			}
+		}
+	}
+
+	void insertRobinHood(Customer* customer) {
+		int slot = home(customer->result, customer->ID);
+		int dist = 0;
+		while (table[slot] != nullptr) {
+			int other = distance(home(table[slot]->result, table[slot]->ID), slot);
+			if (other < dist) {
+				Customer* poorer = table[slot];
+				place(customer, slot);
+				customer = poorer;
+				dist = other;
+			}
+			slot = (slot + 1) % slot_count;
+			dist++;
+		}
+		place(customer, slot);
+	}
+
+	void removeRobinHood(int slot) {
+		table[slot] = nullptr;
+		int next = (slot + 1) % slot_count;
+		while (table[next] != nullptr && home(table[next]->result, table[next]->ID) != next) {
+			place(table[next], slot);
+			table[next] = nullptr;
+			slot = next;
+			next = (next + 1) % slot_count;
+		}
+	}
+public:
+	bool isFull() {
+		return size >= max_size;
+	}
+	HashTable(int max_size = MAXSIZE / 2, bool robin_hood = false) {
+		size = 0;
+		this->max_size = max_size;
+		this->robin_hood = robin_hood;
+		this->slot_count = robin_hood ? 2 * max_size : max_size;
+		table.resize(slot_count, nullptr);
+		if (!robin_hood) {
+			deleted.resize(slot_count, false);
+			used.reset(slot_count);
+		}
+	}
+	int hash_function(int result) {
+		return result % max_size;
+	}
+
+	// false if the table is full
+	bool insert(Customer* customer) {
+		// insert new customer
+		if (size >= max_size) {
+			// table is full
+			return false;
+		}
+		if (robin_hood) {
+			insertRobinHood(customer);
+		} else {
+			insertLinear(customer);
+		}
+		size++;
+		return true;
+	}
+
+	// keyed lookup, probes from the home slot of result
+	Customer* find(int result, int ID) {
+		int slot = home(result, ID);
+		for (int i = 0; i < slot_count; i++) {
+			if (table[slot] == nullptr && (robin_hood || !deleted[slot])) {
+				return nullptr;
+			}
+			if (table[slot] != nullptr && table[slot]->ID == ID) {
+				return table[slot];
+			}
+			slot = (slot + 1) % slot_count;
+		}
+		return nullptr;
+	}
+
+	void remove(Customer* customer) {
+		if (customer == nullptr || customer->slot < 0 || table[customer->slot] != customer) {
+			return;
+		}
+		if (robin_hood) {
+			removeRobinHood(customer->slot);
+		} else {
+			removeLinear(customer->slot);
+		}
+		customer->slot = -1;
+		size--;
+	}
+
+	// probe lengths of the customers in the table right now
+	ProbeStats getProbeStats() {
+		ProbeStats stats;
+		stats.entries = 0;
+		stats.average = 0;
+		stats.max = 0;
+		long long total = 0;
+		for (int i = 0; i < slot_count; i++) {
+			if (table[i] != nullptr) {
+				int probes = distance(home(table[i]->result, table[i]->ID), i) + 1;
+				total += probes;
+				stats.max = max(stats.max, probes);
+				stats.entries++;
+			}
+		}
+		if (stats.entries > 0) {
+			stats.average = (double)total / stats.entries;
+		}
+		return stats;
+	}
+
+	void print(OutputSink& out) {
+		for (int i = 0; i < slot_count; i++) {
+			if (table[i] != nullptr) {
+				out.writeLine(table[i]->ID, table[i]->result, table[i]->num);
+			}
+		}
+	}
+
+	int getSlotCount() {
+		return slot_count;
+	}
+
+	bool isTombstone(int slot) {
+		return !robin_hood && deleted[slot];
+	}
+
+	// puts a customer back at the slot it had in a snapshot, false if the slot
+	// is out of range or taken
+	bool restore(Customer* customer, int slot) {
+		if (slot < 0 || slot >= slot_count || table[slot] != nullptr || size >= max_size) {
+			return false;
+		}
+		place(customer, slot);
+		if (!robin_hood) {
+			used.set(slot, true);
+		}
+		size++;
+		return true;
+	}
+
+	bool restoreTombstone(int slot) {
+		if (robin_hood || slot < 0 || slot >= slot_count || table[slot] != nullptr) {
+			return false;
+		}
+		deleted[slot] = true;
+		return true;
+	}
+
+	// unlinks every customer, the records themselves belong to the caller
+	void clear() {
+		for (int i = 0; i < slot_count; i++) {
+			if (table[i] != nullptr) {
+				table[i]->slot = -1;
+				table[i] = nullptr;
+			}
+		}
+		if (!robin_hood) {
+			fill(deleted.begin(), deleted.end(), false);
+			used.reset(slot_count);
+		}
+		size = 0;
+	}
+};
+
+// ordered by (result, seq) where seq grows with every insert. Equal results
+// went right of each other in insertion order anyway, so the tree (and the
+// PrintAVL output) is the same as ordering by result alone, but a lookup
+// follows one path instead of searching both sides of an equal result.
+// The nodes sit in one array with 32 bit links and point back at their
+// customer; insert and remove walk down once and rebalance up an explicit path
+class AVLTree {
+private:
+	// 32 bytes, the key is kept next to the links so a search never touches the customers
+	class Node {
+	public:
+		long long seq;
+		Customer* customer;
+		int result;
+		uint32_t left;
+		uint32_t right;
+		int height;
+	};
+	static const int MAX_HEIGHT = 64; // an AVL tree of 2^32 nodes is under 48 high
+
+	vector<Node> nodes; // by index, a removed node goes on the free list
+	uint32_t free_list; // linked through left
+	uint32_t root;
+	int size;
+	int max_size;
+	long long next_seq;
+
+	// -1, 0, 1 as (result, seq) is before, equal to, after node's key
+	int compare(int result, long long seq, uint32_t node) {
+		if (result != nodes[node].result) {
+			return result < nodes[node].result ? -1 : 1;
+		}
+		if (seq != nodes[node].seq) {
+			return seq < nodes[node].seq ? -1 : 1;
+		}
+		return 0;
+	}
+
+	int getHeight(uint32_t node) {
+		if (node == NONE) {
+			return 0;
+		}
+		return nodes[node].height;
+	}
+
+	void updateHeight(uint32_t node) {
+		nodes[node].height = max(getHeight(nodes[node].left), getHeight(nodes[node].right)) + 1;
+	}
+
+	uint32_t rotateLeft(uint32_t node) {
+		uint32_t right = nodes[node].right;
+		nodes[node].right = nodes[right].left;
+		nodes[right].left = node;
+		updateHeight(node);
+		updateHeight(right);
+		return right;
+	}
+
+	uint32_t rotateRight(uint32_t node) {
+		uint32_t left = nodes[node].left;
+		nodes[node].left = nodes[left].right;
+		nodes[left].right = node;
+		updateHeight(node);
+		updateHeight(left);
+		return left;
+	}
+
+	int getBalance(uint32_t node) {
+		if (node == NONE) {
+			return 0;
+		}
+		return getHeight(nodes[node].left) - getHeight(nodes[node].right);
+	}
+
+	// node after (result, seq) went into one of its subtrees, returns the root of the subtree
+	uint32_t balanceInsert(uint32_t node, int result, long long seq) {
+		updateHeight(node);
+		int balance = getBalance(node);
+		// left left case
+		if (balance > 1 && compare(result, seq, nodes[node].left) < 0) {
+			return rotateRight(node);
+		}
+		// right right case
+		if (balance < -1 && compare(result, seq, nodes[node].right) >= 0) {
+			return rotateLeft(node);
+		}
+		// left right case
+		if (balance > 1 && compare(result, seq, nodes[node].left) >= 0) {
+			nodes[node].left = rotateLeft(nodes[node].left);
+			return rotateRight(node);
+		}
+		// right left case
+		if (balance < -1 && compare(result, seq, nodes[node].right) < 0) {
+			nodes[node].right = rotateRight(nodes[node].right);
+			return rotateLeft(node);
+		}
+		return node;
+	}
+
+	// node after a removal from one of its subtrees, returns the root of the subtree
+	uint32_t balanceRemove(uint32_t node) {
+		updateHeight(node);
+		int balance = getBalance(node);
+		// ll
+		if (balance > 1 && getBalance(nodes[node].left) >= 0) {
+			return rotateRight(node);
+		}
+		// lr
+		if (balance > 1 && getBalance(nodes[node].left) < 0) {
+			nodes[node].left = rotateLeft(nodes[node].left);
+			return rotateRight(node);
+		}
+		// rr
+		if (balance < -1 && getBalance(nodes[node].right) <= 0) {
+			return rotateLeft(node);
+		}
+		// rl
+		if (balance < -1 && getBalance(nodes[node].right) > 0) {
+			nodes[node].right = rotateRight(nodes[node].right);
+			return rotateLeft(node);
+		}
+		return node;
+	}
+
+	// points parent (root when NONE) at to instead of its child from
+	void relink(uint32_t parent, uint32_t from, uint32_t to) {
+		if (parent == NONE) {
+			root = to;
+		} else if (nodes[parent].left == from) {
+			nodes[parent].left = to;
+		} else {
+			nodes[parent].right = to;
+		}
+	}
+
+	// rebalances path[count - 1] up to path[0], the nodes a change went under
+	template <class Balance>
+	void rebalance(uint32_t path[], int count, Balance balance) {
+		for (int i = count - 1; i >= 0; i--) {
+			uint32_t top = balance(path[i]);
+			if (top != path[i]) {
+				relink(i > 0 ? path[i - 1] : NONE, path[i], top);
+			}
+		}
+	}
+
+	uint32_t newNode(Customer* customer) {
+		uint32_t node;
+		if (free_list != NONE) {
+			node = free_list;
+			free_list = nodes[node].left;
+		} else {
+			node = nodes.size();
+			nodes.emplace_back();
+		}
+		nodes[node].seq = customer->seq;
+		nodes[node].customer = customer;
+		nodes[node].result = customer->result;
+		nodes[node].left = NONE;
+		nodes[node].right = NONE;
+		nodes[node].height = 1;
+		customer->node = node;
+		return node;
+	}
+
+	void freeNode(uint32_t node) {
+		nodes[node].customer->node = NONE;
+		nodes[node].customer = nullptr;
+		nodes[node].left = free_list;
+		free_list = node;
+	}
+
+	Customer* customerAt(uint32_t node) {
+		return node == NONE ? nullptr : nodes[node].customer;
+	}
+
+	// true if the links from root reach each of the count nodes exactly once,
+	// in key order, with the stored heights and balanced. A shared child or a
+	// cycle is a node reached twice
+	bool isWellFormed(int count) {
+		vector<uint32_t> order; // parents before children
+		vector<bool> seen(count, false);
+		if (root != NONE) {
+			order.push_back(root);
+			seen[root] = true;
+		}
+		for (size_t i = 0; i < order.size(); i++) {
+			for (uint32_t child : {nodes[order[i]].left, nodes[order[i]].right}) {
+				if (child == NONE) {
+					continue;
+				}
+				if (seen[child]) {
+					return false;
+				}
+				seen[child] = true;
+				order.push_back(child);
+			}
+		}
+		if ((int)order.size() != count) {
+			return false;
+		}
+		for (int i = count - 1; i >= 0; i--) {
+			uint32_t node = order[i];
+			int left = getHeight(nodes[node].left);
+			int right = getHeight(nodes[node].right);
+			if (abs(left - right) > 1 || nodes[node].height != max(left, right) + 1) {
+				return false;
+			}
+		}
+		// in order, each key after the one before
+		vector<uint32_t> stack;
+		uint32_t prev = NONE;
+		for (uint32_t node = root; node != NONE || !stack.empty(); ) {
+			if (node != NONE) {
+				stack.push_back(node);
+				node = nodes[node].left;
+				continue;
+			}
+			node = stack.back();
+			stack.pop_back();
+			if (prev != NONE && compare(nodes[node].result, nodes[node].seq, prev) <= 0) {
+				return false;
+			}
+			prev = node;
+			node = nodes[node].right;
+		}
+		return true;
+	}
+public:
+	static const uint32_t NONE = ~0U;
+
+	AVLTree(int max_size = MAXSIZE / 2) {
+		size = 0;
+		root = NONE;
+		free_list = NONE;
+		this->max_size = max_size;
+		this->next_seq = 0;
+	}
+
+	// unlinks every customer, the records themselves belong to the caller
+	void clear() {
+		for (Node& node : nodes) {
+			if (node.customer != nullptr) {
+				node.customer->node = NONE;
+			}
+		}
+		nodes.clear();
+		free_list = NONE;
+		root = NONE;
+		size = 0;
+	}
+
+	Customer* getRoot() {
+		return customerAt(root);
+	}
+
+	// the children and height of a customer in the tree, for snapshots
+	Customer* getLeft(Customer* customer) {
+		return customerAt(nodes[customer->node].left);
+	}
+	Customer* getRight(Customer* customer) {
+		return customerAt(nodes[customer->node].right);
+	}
+	int getHeight(Customer* customer) {
+		return nodes[customer->node].height;
+	}
+
+	long long getNextSeq() {
+		return next_seq;
+	}
+
+	// takes over a tree from a snapshot: customers with their seq set, and the
+	// children (indexes into customers, -1 for none) and height of each.
+	// False if the links are not one AVL tree over all the customers
+	bool restore(vector<Customer*>& customers, vector<int>& left, vector<int>& right, vector<int>& height, int root, long long next_seq) {
+		int count = customers.size();
+		if (count > max_size || root >= count || (root < 0 && count > 0)) {
+			return false;
+		}
+		clear();
+		for (Customer* customer : customers) {
+			newNode(customer);
+		}
+		for (int i = 0; i < count; i++) {
+			if (left[i] >= count || right[i] >= count) {
+				return false;
+			}
+			nodes[i].left = left[i] < 0 ? NONE : left[i];
+			nodes[i].right = right[i] < 0 ? NONE : right[i];
+			nodes[i].height = height[i];
+		}
+		this->root = root < 0 ? NONE : root;
+		this->size = count;
+		this->next_seq = next_seq;
+		return isWellFormed(count);
+	}
+
+	int getSize() {
+		return this->size;
+	}
+	bool isFull() {
+		return this->size >= max_size;
+	}
+
+	// gives the customer its seq, (result, seq) finds it again; false if full
+	bool insert(Customer* customer) {
+		if (this->size >= max_size) {
+			return false;
+		}
+		customer->seq = next_seq++;
+		int result = customer->result;
+		long long seq = customer->seq;
+		uint32_t path[MAX_HEIGHT];
+		int count = 0;
+		uint32_t parent = NONE;
+		for (uint32_t node = root; node != NONE; ) {
+			path[count++] = node;
+			parent = node;
+			node = compare(result, seq, node) < 0 ? nodes[node].left : nodes[node].right;
+		}
+		uint32_t added = newNode(customer);
+		if (parent == NONE) {
+			root = added;
+		} else if (compare(result, seq, parent) < 0) {
+			nodes[parent].left = added;
+		} else {
+			nodes[parent].right = added;
+		}
+		size++;
+		rebalance(path, count, [&](uint32_t node) { return balanceInsert(node, result, seq); });
+		return true;
+	}
+
+	Customer* find(int result, long long seq) {
+		uint32_t node = root;
+		while (node != NONE) {
+			int side = compare(result, seq, node);
+			if (side == 0) {
+				return nodes[node].customer;
+			}
+			node = side < 0 ? nodes[node].left : nodes[node].right;
+		}
+		return nullptr;
+	}
+
+	// a node with two children is replaced by its successor, which leaves the
+	// same shape the old copy of the successor's data did
+	void remove(Customer* customer) {
+		if (this->size <= 0 || customer == nullptr || customer->node == NONE) {
+			return;
+		}
+		int result = customer->result;
+		long long seq = customer->seq;
+		uint32_t path[MAX_HEIGHT];
+		int count = 0;
+		uint32_t node = root;
+		while (node != NONE) {
+			int side = compare(result, seq, node);
+			if (side == 0) {
+				break;
+			}
+			path[count++] = node;
+			node = side < 0 ? nodes[node].left : nodes[node].right;
+		}
+		if (node == NONE) {
+			return;
+		}
+		uint32_t parent = count > 0 ? path[count - 1] : NONE;
+		if (nodes[node].left == NONE || nodes[node].right == NONE) {
+			// node with one child or no child
+			relink(parent, node, nodes[node].left != NONE ? nodes[node].left : nodes[node].right);
+		} else {
+			// two children: the successor is unlinked from the right subtree and takes node's place
+			int at = count;
+			path[count++] = node;
+			uint32_t successor = nodes[node].right;
+			while (nodes[successor].left != NONE) {
+				path[count++] = successor;
+				successor = nodes[successor].left;
+			}
+			relink(path[count - 1], successor, nodes[successor].right);
+			nodes[successor].left = nodes[node].left;
+			nodes[successor].right = nodes[node].right;
+			relink(parent, node, successor);
+			path[at] = successor;
+		}
+		freeNode(node);
+		size--;
+		rebalance(path, count, [&](uint32_t node) { return balanceRemove(node); });
+	}
+
+	void print(OutputSink& out) {
+		// print bfs
+		// "ID-result-num"
+		if (size <= 0) {
+			return;
+		}
+		vector<uint32_t> queue;
+		queue.reserve(size);
+		queue.push_back(root);
+		for (size_t i = 0; i < queue.size(); i++) {
+			if (i + 8 < queue.size()) { // the queue is known ahead, start the walk out to the customer early
+				__builtin_prefetch(nodes[queue[i + 8]].customer);
+			}
+			Node& node = nodes[queue[i]];
+			if (node.left != NONE) {
+				queue.push_back(node.left);
+			}
+			if (node.right != NONE) {
+				queue.push_back(node.right);
+			}
+			out.writeLine(node.customer->ID, node.customer->result, node.customer->num);
+		}
+	}
+};
+
+// doubly linked through one ListHook of each customer (FIFO, LRCO or an area
+// list), so a customer is unlinked or moved to the tail in O(1)
+class LinkedList {
+private:
+	ListHook Customer::* hook;
+	Customer* head;
+	Customer* tail;
+	int size;
+
+	ListHook& links(Customer* customer) {
+		return customer->*hook;
+	}
+
+	void linkBack(Customer* customer) {
+		links(customer).next = NULL;
+		links(customer).prev = tail;
+		if (tail == NULL) {
+			head = customer;
+		} else {
+			links(tail).next = customer;
+		}
+		tail = customer;
+	}
+
+	void unlink(Customer* customer) {
+		ListHook& node = links(customer);
+		if (node.prev == NULL) {
+			head = node.next;
+		} else {
+			links(node.prev).next = node.next;
+		}
+		if (node.next == NULL) {
+			tail = node.prev;
+		} else {
+			links(node.next).prev = node.prev;
+		}
+		node.next = NULL;
+		node.prev = NULL;
+	}
+
+public:
+	LinkedList(ListHook Customer::* hook) {
+		this->hook = hook;
+		size = 0;
+		head = nullptr;
+		tail = nullptr;
+	}
+
+	void pushBack(Customer* customer) {
+		linkBack(customer);
+		size++;
+	}
+
+	void removeHead() {
+		removeNode(head);
+	}
+
+	int getSize() {
+		return this->size;
+	}
+
+	// new order: the customer becomes the most recent one
+	void moveToBack(Customer* customer) {
+		if (customer == tail) {
+			return;
+		}
+		unlink(customer);
+		linkBack(customer);
+	}
+
+	Customer* getHead() {
+		return head;
+	}
+
+	Customer* next(Customer* customer) {
+		return links(customer).next;
+	}
+
+	void removeNode(Customer* customer) {
+		if (customer == NULL) {
+			return;
+		}
+		unlink(customer);
+		size--;
+	}
+};
+
+// every customer knows its index in heap, so it is updated or removed without searching
+class MinHeap {
+private:
+
+	vector<Customer*> heap;
+	int max_size;
+	int size;
+	int increase_num;
+
+	int parent(int i) {
+		return (i - 1) / 2;
+	}
+
+	int left(int i) {
+		return 2 * i + 1;
+	}
+
+	int right(int i) {
+		return 2 * i + 2;
+	}
+
+	void swap(int a, int b) {
+		Customer* temp = heap[a];
+		heap[a] = heap[b];
+		heap[b] = temp;
+		heap[a]->pos = a;
+		heap[b]->pos = b;
+	}
+
+	void place(Customer* customer, int pos) {
+		heap[pos] = customer;
+		customer->pos = pos;
+	}
+
+	void push(Customer* customer) {
+		place(customer, size++);
+		reheapUp(size-1);
+	}
+
+	// takes the customer at pos out of the heap: the last one fills the hole and is
+	// only moved down, PrintMH output depends on this exact order
+	Customer* detach(int pos) {
+		Customer* customer = heap[pos];
+		if (pos != size - 1) {
+			place(heap[size-1], pos);
+		}
+		heap[size-1] = nullptr;
+		size--;
+		reheapDown(pos);
+		customer->pos = -1;
+		return customer;
+	}
+
+	void reheapUp(int pos) {
+		if (pos <= 0 || pos >= size) {
+			return;
+		}
+		if (heap[parent(pos)]->num > heap[pos]->num || (heap[parent(pos)]->num == heap[pos]->num && heap[parent(pos)]->priority > heap[pos]->priority)) {
+			swap(parent(pos), pos);
+			reheapUp(parent(pos));
+		}
+	}
+
+	void reheapDown(int pos) {
+		if (pos < 0 || pos >= size - 1) {
+			return;
+		}
+
+		int l = left(pos);
+		if (l > size-1) {
+			return;
+		}
+		int r = right(pos);
+		int min_child;
+
+		if (r > size-1) {
+			min_child = l;
+		} else {
+			if (heap[l]->num < heap[r]->num || (heap[l]->num == heap[r]->num && heap[l]->priority < heap[r]->priority)) {
+				min_child = l;
+			} else {
+				min_child = r;
+			}
+		}
+
+		if (heap[pos]->num > heap[min_child]->num || (heap[pos]->num == heap[min_child]->num && heap[pos]->priority > heap[min_child]->priority)) {
+			swap(pos, min_child);
+			reheapDown(min_child);
+		}
+	}
+public:
+	MinHeap(int max_size = MAXSIZE) {
+		this->max_size = max_size;
+		heap.resize(max_size, nullptr);
+		this->size = 0;
+		this->increase_num = 0;
+	}
+
+	// false if the heap is full
+	bool insert(Customer* customer) {
+		if (this->size >= max_size) {
+			return false;
+		}
+		customer->priority = increase_num++;
+		push(customer);
+		return true;
+	}
+
+	// new order, called after the customer's num went up: it leaves its place
+	// and comes back in at the end with the same priority, O(log n)
+	void updateNum(Customer* customer) {
+		if (customer == nullptr || customer->pos < 0) {
+			return;
+		}
+		detach(customer->pos);
+		push(customer);
+	}
+
+	void remove(int pos) {
+		if (pos < 0 || pos >= size || size == 0) {
+			return;
+		}
+		detach(pos);
+	}
+
+	void remove(Customer* customer) {
+		if (customer == nullptr) {
+			return;
+		}
+		remove(customer->pos);
+	}
+
+	// bulk removal: drop() leaves a hole for each customer, heapify() then packs
+	// the rest in array order and rebuilds the heap in O(n). No other call in
+	// between. PrintMH order is not the one of removing them one by one
+	void drop(Customer* customer) {
+		if (customer == nullptr || customer->pos < 0) {
+			return;
+		}
+		heap[customer->pos] = nullptr;
+		customer->pos = -1;
+	}
+
+	void heapify() {
+		int kept = 0;
+		for (int i = 0; i < size; i++) {
+			if (heap[i] != nullptr) {
+				place(heap[i], kept++);
+			}
+		}
+		fill(heap.begin() + kept, heap.begin() + size, nullptr);
+		size = kept;
+		for (int i = size / 2 - 1; i >= 0; i--) {
+			reheapDown(i);
+		}
+	}
+
+	Customer* getHead() {
+		return heap[0];
+	}
+
+	int getSize() {
+		return size;
+	}
+
+	Customer* at(int pos) {
+		return heap[pos];
+	}
+
+	int getIncreaseNum() {
+		return increase_num;
+	}
+
+	// the heap of a snapshot, in array order
+	bool restore(const vector<Customer*>& order, int increase_num) {
+		if ((int)order.size() > max_size) {
+			return false;
+		}
+		for (Customer* customer : order) {
+			place(customer, size++);
+		}
+		this->increase_num = increase_num;
+		return true;
+	}
+
+	void removeTop() {
+		remove(0);
+	}
+
+	void print(int index, OutputSink& out) {
+		if (index >= size) {
+			return;
+		}
+		out.writeLine(heap[index]->ID, heap[index]->num);
+		print(left(index), out);
+		print(right(index), out);
+	}
+	void print(OutputSink& out) {
+		print(0, out);
+	}
+};
+
+// name <-> 32 bit symbol. Each name is hashed and stored once, everything
+// else carries and compares the symbol. A released symbol is handed out again.
+// The table is open addressed with linear probing, at most half full, and a
+// release shifts the run after it back, so it needs no tombstones and frees nothing
+class SymbolTable {
+private:
+	vector<uint32_t> slots; // symbol or NONE, a power of two long
+	size_t mask;
+	int size;
+	deque<string> names; // by symbol, a deque so the strings never move
+	vector<size_t> hashes; // by symbol
+	vector<uint32_t> free_symbols;
+
+	// the slot of name, or of the empty slot that ends its run
+	size_t probe(string_view name, size_t name_hash) {
+		size_t slot = name_hash & mask;
+		while (slots[slot] != NONE && (hashes[slots[slot]] != name_hash || names[slots[slot]] != name)) {
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	void grow() {
+		vector<uint32_t> old;
+		old.swap(slots);
+		slots.resize(old.size() * 2, NONE);
+		mask = slots.size() - 1;
+		for (uint32_t symbol : old) {
+			if (symbol != NONE) {
+				size_t slot = hashes[symbol] & mask;
+				while (slots[slot] != NONE) {
+					slot = (slot + 1) & mask;
+				}
+				slots[slot] = symbol;
+			}
+		}
+	}
+public:
+	static constexpr uint32_t NONE = ~0U;
+
+	SymbolTable(int size = 0) {
+		size_t slot_count = 16;
+		while (slot_count < 2 * (size_t)size) {
+			slot_count <<= 1;
+		}
+		slots.resize(slot_count, NONE);
+		mask = slot_count - 1;
+		this->size = 0;
+	}
+
+	// the symbol of name, added = true if the name was not in the table
+	uint32_t intern(string_view name, bool& added) {
+		size_t name_hash = hash<string_view>()(name);
+		size_t slot = probe(name, name_hash);
+		if (slots[slot] != NONE) {
+			added = false;
+			return slots[slot];
+		}
+		uint32_t symbol;
+		if (free_symbols.empty()) {
+			symbol = names.size();
+			names.emplace_back(name);
+			hashes.push_back(name_hash);
+		} else {
+			symbol = free_symbols.back();
+			free_symbols.pop_back();
+			names[symbol].assign(name.data(), name.size());
+			hashes[symbol] = name_hash;
+		}
+		slots[slot] = symbol;
+		added = true;
+		if (++size * 2 > (int)slots.size()) {
+			grow();
+		}
+		return symbol;
+	}
+
+	uint32_t find(string_view name) {
+		return slots[probe(name, hash<string_view>()(name))];
+	}
+
+	string_view name(uint32_t symbol) {
+		return names[symbol];
+	}
+
+	void release(uint32_t symbol) {
+		size_t hole = hashes[symbol] & mask;
+		while (slots[hole] != symbol) {
+			hole = (hole + 1) & mask;
+		}
+		// move back every later entry of the run whose home is not between the hole and it
+		size_t slot = (hole + 1) & mask;
+		while (slots[slot] != NONE) {
+			size_t home = hashes[slots[slot]] & mask;
+			if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+				slots[hole] = slots[slot];
+				hole = slot;
+			}
+			slot = (slot + 1) & mask;
+		}
+		slots[hole] = NONE;
+		size--;
+		free_symbols.push_back(symbol);
+	}
+
+	int getSize() {
+		return size;
+	}
+};
+
+// owns the Customer records: name -> seated customer and table ID -> seated
+// customer, so a REG/CLE never scans the tables. Only seated names are interned,
+// so a name has a symbol exactly while its customer sits at a table
+class CustomerIndex {
+private:
+	CustomerPool pool;
+	SymbolTable symbols;
+	vector<Customer*> customers; // by symbol
+	LinkedList* areas[3]; // by Area
+	vector<Customer*> seats; // seats[ID], nullptr is an empty table
+	SlotBitmap taken_seats; // slot ID - 1
+public:
+	CustomerIndex(int capacity) : pool(min(capacity, 4096)), symbols(capacity) {
+		customers.reserve(capacity + 1);
+		seats.resize(capacity + 1, nullptr);
+		taken_seats.reset(capacity);
+		areas[0] = nullptr;
+		areas[area1] = new LinkedList(&Customer::area_list);
+		areas[area2] = new LinkedList(&Customer::area_list);
+	}
+	~CustomerIndex() {
+		delete areas[area1];
+		delete areas[area2];
+	}
+
+	// the symbol of name, added = true for a name that is not seated. The caller
+	// seats it with insert or gives it back with release
+	uint32_t intern(string_view name, bool& added) {
+		uint32_t symbol = symbols.intern(name, added);
+		if (symbol >= customers.size()) {
+			customers.resize(symbol + 1, nullptr);
+		}
+		return symbol;
+	}
+
+	void release(uint32_t symbol) {
+		symbols.release(symbol);
+	}
+
+	Customer* find(string_view name) {
+		uint32_t symbol = symbols.find(name);
+		return symbol == SymbolTable::NONE ? nullptr : customers[symbol];
+	}
+
+	Customer* bySymbol(uint32_t symbol) {
+		return customers[symbol];
+	}
+
+	string_view name(Customer* customer) {
+		return symbols.name(customer->name);
+	}
+
+	Customer* atSeat(int ID) {
+		if (ID < 1 || ID >= (int)seats.size()) {
+			return nullptr;
+		}
+		return seats[ID];
+	}
+
+	// first empty table from ID on, wrapping past the last table, -1 if all are taken
+	int nextFreeSeat(int ID) {
+		int slot = taken_seats.nextFree(ID - 1);
+		return slot == -1 ? -1 : slot + 1;
+	}
+
+	// a new record, linked into nothing but this index; the caller sets the area
+	Customer* insert(uint32_t symbol, int ID, int result) {
+		Customer* customer = pool.get();
+		customer->reset(ID, result, area1);
+		customer->name = symbol;
+		customers[symbol] = customer;
+		seats[ID] = customer;
+		taken_seats.set(ID - 1, true);
+		return customer;
+	}
+
+	// once per customer, right after insert; customers are seated in FIFO order
+	void setArea(Customer* customer, Area area) {
+		customer->area = area;
+		areas[area]->pushBack(customer);
+	}
+
+	Customer* areaFront(Area area) {
+		return areas[area]->getHead();
+	}
+
+	int areaSize(Area area) {
+		return areas[area]->getSize();
+	}
+
+	// the record goes back to the pool, it must be unlinked from every structure
+	void remove(Customer* customer) {
+		areas[customer->area]->removeNode(customer);
+		seats[customer->ID] = nullptr;
+		taken_seats.set(customer->ID - 1, false);
+		customers[customer->name] = nullptr;
+		symbols.release(customer->name);
+		pool.release(customer);
+	}
+
+	int getSize() {
+		return symbols.getSize();
+	}
+
+	// symbols are below this
+	int getSymbolCount() {
+		return customers.size();
+	}
+};
+
+// what a command did, the stats are kept per outcome
+enum Outcome {
+	outcomeREGNew, outcomeREGRepeat, outcomeEvictFIFO, outcomeEvictLRCO, outcomeEvictLFCO, outcomeREGInvalid,
+	outcomeCLESeat, outcomeCLEEmpty, outcomeCLEArea1, outcomeCLEArea2, outcomeCLEInvalid,
+	outcomePrintHT, outcomePrintAVL, outcomePrintMH, outcomeSnapshot, outcomeUnknown, outcomeCount
+};
+
+// takes a seated customer out of every structure and frees the record
+void removeCustomer(Customer* customer, LinkedList* FIFO, LinkedList* LRCO, MinHeap* LFCO, CustomerIndex& customers, HashTable* area_1, AVLTree* area_2) {
+	if (customer->area == area1) {
+		area_1->remove(customer);
+	} else {
+		area_2->remove(customer);
+	}
+	FIFO->removeNode(customer);
+	LRCO->removeNode(customer);
+	LFCO->remove(customer);
+	customers.remove(customer);
+}
+
+// precomputed = the Huffman result of the name if the caller has it already, -1 = look it up
+// computed, if set, gets the result a new customer was seated with, -1 otherwise
+Outcome reg(string_view command, LinkedList* FIFO, LinkedList* LRCO, MinHeap* LFCO, CustomerIndex& customers, HashTable* area_1, AVLTree* area_2, int capacity, HuffCache& huff_cache, int precomputed = -1, int* computed = nullptr) {
+	// check valid REG command
+	if (command == "REG" || command == "REG ") {
+		return outcomeREGInvalid;
+	}
+
+	string_view name = command.substr(command.find(" ") + 1);
+	if (!checkName(name)) {
+		return outcomeREGInvalid;
+	}
+
+	// MAIN FUNCTION
+	// check if result is [new_customer] or [new_order]
+	bool added;
+	uint32_t symbol = customers.intern(name, added);
+	Customer* customer = added ? nullptr : customers.bySymbol(symbol);
+
+	if (customer) { // [new_order]
+		// one num for area 1 / area 2 and LFCO, then LRCO and LFCO reorder
+		customer->num++;
+		LRCO->moveToBack(customer);
+		LFCO->updateNum(customer);
+		return outcomeREGRepeat;
+	} else { // [new_customer]
+		// get Huffcode
+		int result = precomputed >= 0 ? precomputed : huff_cache.getResult(name);
+		if (computed != nullptr) {
+			*computed = result;
+		}
+		int ID;
+		Outcome outcome = outcomeREGNew;
+		if (FIFO->getSize() >= capacity) { // full
+
+			int OPT = result % 3;
+			outcome = (Outcome)(outcomeEvictFIFO + OPT);
+			Customer* victim = nullptr;
+
+			switch (OPT) {
+				case 0: { // FIFO
+					victim = FIFO->getHead();
+					break;
+				}
+				case 1: { // LRCO
+					victim = LRCO->getHead();
+					break;
+				}
+				case 2: { // LFCO
+					victim = LFCO->getHead();
+					break;
+				}
+			}
+
+			ID = victim->ID;
+			removeCustomer(victim, FIFO, LRCO, LFCO, customers, area_1, area_2);
+		} else { // not full
+			// find ID
+			ID = customers.nextFreeSeat(result % capacity + 1);
+
+			if (ID == -1) {
+				cout << "error" << endl;
+				customers.release(symbol);
+				return outcomeREGInvalid;
+			}
+		}
+		// cout << result << "-" << ID << endl; // del
+		customer = customers.insert(symbol, ID, result);
+
+		// choose area
+		Area area;
+		if (result % 2 == 1) { // insert to area 1
+			if (area_1->isFull()) {
+				area_2->insert(customer);
+				area = area2;
+			} else {
+				area_1->insert(customer);
+				area = area1;
+			}
+		} else { // insert to area 2
+			if (area_2->isFull()) {
+				area_1->insert(customer);
+				area = area1;
+			} else {
+				area_2->insert(customer);
+				area = area2;
+			}
+		}
+		// update FIFO, LRCO, min_heap, table
+		customers.setArea(customer, area);
+		FIFO->pushBack(customer);
+		LRCO->pushBack(customer);
+		LFCO->insert(customer);
+		return outcome;
+	}
+}
+
+// heapify_wipe: an area wipe rebuilds LFCO in one pass instead of removing
+// its customers one at a time, faster but PrintMH order differs afterwards.
+// A wipe that leaves at most 2 customers always rebuilds: priorities are
+// unique, so such a heap has only one order either way
+Outcome cle(string_view command, LinkedList* FIFO, LinkedList* LRCO, MinHeap* LFCO, CustomerIndex& customers, HashTable* area_1, AVLTree* area_2, int capacity, bool heapify_wipe = false) {
+	// check valid CLE command
+	if (command == "CLE" || command == "CLE ") {
+		return outcomeCLEInvalid;
+	}
+
+	string_view NUM = command.substr(command.find(" ") + 1);
+	if (!checkID(NUM)) {
+		return outcomeCLEInvalid;
+	}
+	int ID;
+	if (from_chars(NUM.data(), NUM.data() + NUM.size(), ID).ec != errc()) {
+		return outcomeCLEInvalid; // "-" alone or out of int range
+	}
+
+	if (ID < 1 || ID > capacity) {	// clear area 1 / area 2
+		// empty the area at once, then update FIFO, LRCO, LFCO, table.
+		// The area list is in FIFO order, LFCO must drop them in that order
+		Area area = ID < 1 ? area1 : area2;
+		bool heapify = heapify_wipe || LFCO->getSize() - customers.areaSize(area) <= 2;
+		if (area == area1) {
+			area_1->clear();
+		} else {
+			area_2->clear();
+		}
+		Customer* customer = customers.areaFront(area);
+		while (customer) {
+			Customer* next = customer->area_list.next;
+			FIFO->removeNode(customer);
+			LRCO->removeNode(customer);
+			if (heapify) {
+				LFCO->drop(customer);
+			} else {
+				LFCO->remove(customer);
+			}
+			customers.remove(customer);
+			customer = next;
+		}
+		if (heapify) {
+			LFCO->heapify();
+		}
+		return area == area1 ? outcomeCLEArea1 : outcomeCLEArea2;
+	} else {
+		Customer* customer = customers.atSeat(ID);
+		if (customer) {	// table is not empty
+			removeCustomer(customer, FIFO, LRCO, LFCO, customers, area_1, area_2);
+			return outcomeCLESeat;
+		} else { // table is empty
+			// do nothing
+			return outcomeCLEEmpty;
+		}
+	}
+}
+
+void printHT(HashTable *area_1, OutputSink& out) {
+	area_1->print(out);
+}
+
+void printAVL(AVLTree *area_2, OutputSink& out) {
+	area_2->print(out);
+}
+
+void printMH(MinHeap *LFCO, OutputSink& out) {
+	LFCO->print(out);
+}
+
+// a whole file mapped read only, empty if it can't be opened
+class MappedFile {
+private:
+	const char* data;
+	size_t size;
+public:
+	MappedFile(string filename) {
+		data = nullptr;
+		size = 0;
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return;
+		}
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				data = (const char*)mapping;
+				size = info.st_size;
+				madvise(mapping, size, MADV_SEQUENTIAL);
+			}
+		}
+		close(fd);
+	}
+	~MappedFile() {
+		if (data != nullptr) {
+			munmap((void*)data, size);
+		}
+	}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* getData() {
+		return data;
+	}
+	size_t getSize() {
+		return size;
+	}
+};
+
+// maps the whole command file and hands out one line at a time as a view into
+// the mapping, lines are split the same way getline does
+class CommandReader {
+private:
+	MappedFile file;
+	size_t pos;
+public:
+	CommandReader(string filename) : file(filename) {
+		pos = 0;
+	}
+
+	bool next(string_view& line) {
+		size_t size = file.getSize();
+		if (pos >= size) {
+			return false;
+		}
+		const char* data = file.getData();
+		const char* end = (const char*)memchr(data + pos, '\n', size - pos);
+		size_t length = end ? end - (data + pos) : size - pos;
+		line = string_view(data + pos, length);
+		pos += length + 1;
+		return true;
+	}
+};
+
+// fixed width fields in native byte order, the snapshot file is built in memory
+class SnapshotWriter {
+private:
+	string data;
+public:
+	template <class T>
+	void put(T value) {
+		data.append((const char*)&value, sizeof(T));
+	}
+
+	void putBytes(string_view bytes) {
+		data.append(bytes.data(), bytes.size());
+	}
+
+	// written to filename.tmp, synced and renamed over filename, so a crash
+	// leaves either the old snapshot or the new one
+	bool save(string filename) {
+		string temp = filename + ".tmp";
+		int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			return false;
+		}
+		size_t done = 0;
+		while (done < data.size()) {
+			ssize_t written = ::write(fd, data.data() + done, data.size() - done);
+			if (written <= 0) {
+				close(fd);
+				return false;
+			}
+			done += written;
+		}
+		bool ok = fsync(fd) == 0;
+		ok = close(fd) == 0 && ok;
+		return ok && rename(temp.c_str(), filename.c_str()) == 0;
+	}
+};
+
+// reads what SnapshotWriter wrote, a read past the end returns 0 and clears ok
+class SnapshotReader {
+private:
+	const char* data;
+	size_t size;
+	size_t pos;
+	bool ok;
+public:
+	SnapshotReader(const char* data, size_t size) {
+		this->data = data;
+		this->size = size;
+		pos = 0;
+		ok = true;
+	}
+
+	template <class T>
+	T get() {
+		T value = T();
+		if (size - pos < sizeof(T)) {
+			ok = false;
+			pos = size;
+			return value;
+		}
+		memcpy(&value, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return value;
+	}
+
+	string_view getBytes(size_t length) {
+		if (size - pos < length) {
+			ok = false;
+			pos = size;
+			return string_view();
+		}
+		string_view bytes(data + pos, length);
+		pos += length;
+		return bytes;
+	}
+
+	bool isOk() {
+		return ok;
+	}
+	bool atEnd() {
+		return pos == size;
+	}
+	size_t getRemaining() {
+		return size - pos;
+	}
+};
+
+enum Command {cmdREG, cmdCLE, cmdPrintHT, cmdPrintAVL, cmdPrintMH, cmdSnapshot, cmdUnknown};
+
+Command getCommand(string_view key) {
+	switch (key.size()) {
+		case 3:
+			if (key == "REG") {
+				return cmdREG;
+			}
+			if (key == "CLE") {
+				return cmdCLE;
+			}
+			if (key == "SNP") {
+				return cmdSnapshot;
+			}
+			break;
+		case 7:
+			if (key == "PrintHT") {
+				return cmdPrintHT;
+			}
+			if (key == "PrintMH") {
+				return cmdPrintMH;
+			}
+			break;
+		case 8:
+			if (key == "PrintAVL") {
+				return cmdPrintAVL;
+			}
+			break;
 	}
+	return cmdUnknown;
+}
 
-	void insert(int ID, int result, string name) {
-		// insert new customer
-		if (size >= max_size) {
-			// table is full
-			return;
-		}
-		HashNode* node = new HashNode(ID, result, name, 1);
-		int index = hash_function(node->result);
-		while (table[index] != nullptr) {
-			index = (index + 1) % max_size;
+#if RESTAURANT_STATS
+// latency histogram with 16 buckets per power of two of ns, so any value is
+// off by at most 1/16 and the whole table stays a fixed 8 KB
+class LatencyHistogram {
+private:
+	static const int BUCKETS = 64 * 16;
+	long long buckets[BUCKETS];
+	long long count;
+	long long total;
+	long long max_ns;
+
+	int bucketOf(unsigned long long ns) {
+		if (ns < 16) {
+			return ns;
 		}
-		table[index] = node;
-		size++;
+		int exponent = 63 - __builtin_clzll(ns);
+		return (exponent - 3) * 16 + ((ns >> (exponent - 4)) & 15);
 	}
 
-	void updateNum(int result, string name) {
-		for (int i = 0; i < max_size; i++) {
-			if (table[i] && table[i]->name == name) {
-				table[i]->num++;
-				return;
-			}
+	// largest ns that falls in bucket i
+	long long upperOf(int i) {
+		if (i < 16) {
+			return i;
 		}
+		int shift = i / 16 - 1;
+		long long lower = (long long)(16 + i % 16) << shift;
+		return lower + (1LL << shift) - 1;
+	}
+public:
+	LatencyHistogram() {
+		fill(buckets, buckets + BUCKETS, 0);
+		count = 0;
+		total = 0;
+		max_ns = 0;
 	}
 
-	void remove(int result, string name) {
-		for (int i = 0; i < max_size; i++) {
-			if (table[i] && table[i]->name == name) {
-				table[i] = nullptr;
-				size--;
-				return;
-			}
+	void record(long long ns) {
+		if (ns < 0) {
+			ns = 0;
 		}
+		buckets[bucketOf(ns)]++;
+		count++;
+		total += ns;
+		max_ns = max(max_ns, ns);
 	}
 
-	void print() {
-		for (int i = 0; i < max_size; i++) {
-			if (table[i] != nullptr) {
-				cout << table[i]->ID << "-" << table[i]->result << "-" << table[i]->num << endl;
+	long long getCount() {
+		return count;
+	}
+
+	long long percentile(double p) {
+		long long target = max(1LL, (long long)ceil(p * count));
+		long long seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += buckets[i];
+			if (seen >= target) {
+				return min(upperOf(i), max_ns);
 			}
 		}
+		return max_ns;
 	}
 
-	void clear() {
-		for (int i = 0; i < max_size; i++) {
-			if (table[i] != nullptr) {
-				delete table[i];
-				table[i] = nullptr;
+	// calls = how often the outcome happened, the histogram only holds the timed ones
+	void writeJSON(ostream& out, long long calls) {
+		out << "{\"count\": " << calls << ", \"timed\": " << count
+			<< ", \"mean_ns\": " << (count ? total / count : 0)
+			<< ", \"p50_ns\": " << percentile(0.5) << ", \"p99_ns\": " << percentile(0.99)
+			<< ", \"p999_ns\": " << percentile(0.999) << ", \"max_ns\": " << max_ns
+			<< ", \"histogram\": [";
+		bool first = true;
+		for (int i = 0; i < BUCKETS; i++) {
+			if (buckets[i] == 0) {
+				continue;
 			}
+			out << (first ? "" : ", ") << "[" << upperOf(i) << ", " << buckets[i] << "]";
+			first = false;
 		}
-		size = 0;
+		out << "]}";
 	}
 };
 
-class AVLTree {
+// call count and latency of every Outcome
+class CommandStats {
 private:
-	class Node {
-	public:
-		int ID;
-		int result; // <- key
-		string name;
-		int num;
-		Node* left;
-		Node* right;
-		int height;
+	LatencyHistogram outcomes[outcomeCount];
+	long long calls[outcomeCount];
+	long long reg_calls;
+public:
+	CommandStats() {
+		fill(calls, calls + outcomeCount, 0);
+		reg_calls = 0;
+	}
 
-        Node(int ID, int result, string name) {
-            this->ID = ID;
-            this->result = result;
-			this->name = name;
-			this->num = 1;
-            this->left = nullptr;
-            this->right = nullptr;
-            this->height = 1;
-        }
-		//Node(int ID = 0, int result = 0, Node* left = nullptr, Node* right = nullptr, int height = 1) : ID(ID), result(result), left(left), height(height) {}
-		~Node() {}
-	};
+	// whether this command should be timed
+	bool sample(Command type) {
+		return type != cmdREG || ++reg_calls % RESTAURANT_STATS_SAMPLE == 0;
+	}
 
-	Node* root;
-	int size;
-	const int max_size = MAXSIZE / 2;
+	void count(Outcome outcome) {
+		calls[outcome]++;
+	}
 
-	int const getHeight(Node* node) {
-		if (node == nullptr) {
-			return 0;
+	void record(Outcome outcome, long long ns) {
+		outcomes[outcome].record(ns);
+	}
+
+	void writeJSON(ostream& out) {
+		const char* names[outcomeCount] = {
+			"REG_new", "REG_repeat", "REG_evict_FIFO", "REG_evict_LRCO", "REG_evict_LFCO", "REG_invalid",
+			"CLE_seat", "CLE_empty", "CLE_area_1", "CLE_area_2", "CLE_invalid",
+			"PrintHT", "PrintAVL", "PrintMH", "SNP", "unknown"
+		};
+		out << "{";
+		for (int i = 0; i < outcomeCount; i++) {
+			out << (i ? ",\n " : "\n ") << "\"" << names[i] << "\": ";
+			outcomes[i].writeJSON(out, calls[i]);
 		}
-		return node->height;
+		out << "\n}" << endl;
 	}
+};
+#endif
 
-	void updateHeight(Node* node) {
-		if (node == nullptr) {
-			return;
+// what PrintHT, PrintAVL and PrintMH printed at one moment, never changed once published
+class PrintView {
+public:
+	string ht;
+	string avl;
+	string mh;
+	long long commands; // how many commands the restaurant had run when it was taken
+};
+
+// epoch based reclamation of the PrintViews readers may still be printing.
+// A reader pins the current epoch in its own slot while it holds a view; a
+// retired view is deleted once every reader is idle or pinned a later epoch.
+// retire() is for one writer thread, enter()/leave() for the owner of the slot
+class EpochDomain {
+private:
+	atomic<unsigned long long> epoch;
+	unique_ptr<atomic<unsigned long long>[]> pinned; // by reader, 0 = not holding a view
+	int readers;
+	vector<pair<PrintView*, unsigned long long>> retired; // view, last epoch it could be seen in
+public:
+	EpochDomain(int readers) : epoch(1), pinned(new atomic<unsigned long long>[max(readers, 1)]), readers(max(readers, 1)) {
+		for (int i = 0; i < this->readers; i++) {
+			pinned[i] = 0;
 		}
-		node->height = max(getHeight(node->left), getHeight(node->right)) + 1;
 	}
-	
-	Node *rotateLeft(Node* node) {
-		Node* right = node->right;
-		node->right = right->left;
-		right->left = node;
-		updateHeight(node);
-		updateHeight(right);
-		
-		return right;
+	~EpochDomain() {
+		for (auto& view : retired) {
+			delete view.first;
+		}
 	}
 
-	Node *rotateRight(Node* node) {
-		Node* left = node->left;
-		node->left = left->right;
-		left->right = node;
-		node->height = max(getHeight(node->left), getHeight(node->right)) + 1;
-		left->height = max(getHeight(left->left), getHeight(left->right)) + 1;
-		return left;
+	int getReaders() {
+		return readers;
 	}
 
-	int getBalance(Node* node) {
-		if (node == nullptr) {
-			return 0;
-		} else {
-			return getHeight(node->left) - getHeight(node->right);
-		}
+	void enter(int reader) {
+		pinned[reader] = epoch.load();
 	}
 
-	void deleteAVLTree(Node* node) {
-		if (node == nullptr) {
-			return;
-		} else {
-			deleteAVLTree(node->left);
-			deleteAVLTree(node->right);
-			delete node;
-		}
-		root = nullptr;
-		size = 0;
+	void leave(int reader) {
+		pinned[reader] = 0;
 	}
 
-	Node* insert(Node* node, int ID, int result, string name) {
-		if (node == nullptr) {
-			node = new Node(ID, result, name);
-			size++;
-			return node;
-		}
+	// view must already be unreachable for readers that enter from now on
+	void retire(PrintView* view) {
+		retired.emplace_back(view, epoch.fetch_add(1));
+		reclaim();
+	}
 
-		if (result < node->result) {
-			node->left = insert(node->left, ID, result, name);
-		} else {
-			node->right = insert(node->right, ID, result, name);
+	void reclaim() {
+		unsigned long long oldest = ~0ULL;
+		for (int i = 0; i < readers; i++) {
+			unsigned long long at = pinned[i].load();
+			if (at != 0) {
+				oldest = min(oldest, at);
+			}
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); i++) {
+			if (retired[i].second < oldest) {
+				delete retired[i].first;
+			} else {
+				retired[kept++] = retired[i];
+			}
 		}
+		retired.resize(kept);
+	}
 
-		updateHeight(node);
+	size_t getRetired() {
+		return retired.size();
+	}
+};
 
-		int balance = getBalance(node);
-		// left left case
-		if (balance > 1 && result < node->left->result) {
-			return rotateRight(node);
-		}
-		// right right case
-		if (balance < -1 && result >= node->right->result) {
-			return rotateLeft(node);
-		}
-		// left right case
-		if (balance > 1 && result >= node->left->result) {
-			node->left = rotateLeft(node->left);
-			return rotateRight(node);
+// one restaurant: all the structures of simulate, fed one command line at a time
+// capacity = number of tables in the restaurant, area 1 gets capacity/2 and area 2 the rest
+class Restaurant {
+private:
+	int capacity;
+	LinkedList* FIFO;
+	LinkedList* LRCO;
+	HashTable* area_1;
+	AVLTree* area_2;
+	MinHeap* LFCO;
+	CustomerIndex* customers;
+	HuffCache* huff_cache;
+	OutputSink* out; // where the Print commands write, flushed after each one
+	OutputSink* own_out; // the sink made for an ostream, nullptr for a caller's sink
+	bool heapify_wipe; // see cle
+#if RESTAURANT_STATS
+	CommandStats stats;
+#endif
+
+	// empty structures for capacity tables
+	void build(int capacity) {
+		if (capacity < 2) {
+			capacity = 2;
 		}
-		// right left case
-		if (balance < -1 && result < node->right->result) {
-			node->right = rotateRight(node->right);
-			return rotateLeft(node);
+		if (capacity > MAX_CAPACITY) {
+			capacity = MAX_CAPACITY;
 		}
-		return node;
+		this->capacity = capacity;
+		FIFO = new LinkedList(&Customer::fifo);
+		LRCO = new LinkedList(&Customer::lrco);
+		area_1 = new HashTable(capacity / 2);
+		area_2 = new AVLTree(capacity - capacity / 2);
+		LFCO = new MinHeap(capacity);
+		customers = new CustomerIndex(capacity);
+		huff_cache = new HuffCache(2 * capacity);
 	}
 
-	void updateNum(Node* node, int result, string name) {
-		if (node == nullptr) {
-			return;
-		}
-		if (result < node->result) {
-			updateNum(node->left, result, name);
-		} else if (result > node->result) {
-			updateNum(node->right, result, name);
-		} else if (node->name == name) {
-			node->num++;
-		} else {
-			updateNum(node->left, result, name);
-			updateNum(node->right, result, name);
-		}
+	void destroy() {
+		delete FIFO;
+		delete LRCO;
+		delete LFCO;
+		delete area_1;
+		delete area_2;
+		delete customers;
+		delete huff_cache;
 	}
 
-	Node* minValueNode(Node* node) {
-		if (node == nullptr) {
-			return nullptr;
-		}
-		Node* current = node;
-		while (current->left != nullptr) {
-			current = current->left;
-		}
-		return current;
+	// trades the tables and everything seated at them, output and options stay
+	void swapState(Restaurant& other) {
+		swap(capacity, other.capacity);
+		swap(FIFO, other.FIFO);
+		swap(LRCO, other.LRCO);
+		swap(area_1, other.area_1);
+		swap(area_2, other.area_2);
+		swap(LFCO, other.LFCO);
+		swap(customers, other.customers);
+		swap(huff_cache, other.huff_cache);
 	}
 
-	Node *remove(Node* node, int result, string name) {
-		if (node == nullptr) {
-			return node;
-		}
-		if (result < node->result) {
-			node->left = remove(node->left, result, name);
-		} else if (result > node->result) {
-			node->right = remove(node->right, result, name);
-		} else if (node->name == name) {
-			
-			// Node with one child or no child
-			if ((node->left == nullptr) || (node->right == nullptr)) {
-				Node* temp = node->left ? node->left : node->right;
-				// No child case
-				if (temp == nullptr) {
-					temp = node;   	// ???
-					node = nullptr; // ???
-				} else {
-					// One child case
-					*node = *temp;
+	// the customers of a snapshot in FIFO order, false if the records don't fit
+	// the structures. Names, seats, slots, the AVL shape and that LRCO and the
+	// heap hold each customer once are checked, the heap order is trusted
+	bool restoreCustomers(SnapshotReader& in, int count, long long next_seq, int increase_num) {
+		vector<Customer*> order(count);
+		vector<int> left(count), right(count), height(count);
+		vector<int> tree_index(count, -1); // index among the area 2 customers
+		vector<Customer*> tree;
+		for (int i = 0; i < count; i++) {
+			int ID = in.get<uint32_t>();
+			int result = in.get<uint16_t>();
+			Area area = in.get<uint8_t>() == area1 ? area1 : area2;
+			height[i] = in.get<uint8_t>();
+			int num = in.get<uint32_t>();
+			int priority = in.get<int32_t>();
+			int slot = in.get<int32_t>();
+			long long seq = in.get<int64_t>();
+			left[i] = in.get<int32_t>();
+			right[i] = in.get<int32_t>();
+			string_view name = in.getBytes(in.get<uint32_t>());
+			if (!in.isOk() || ID < 1 || ID > capacity || customers->atSeat(ID) != nullptr || !checkName(name)) {
+				return false;
+			}
+			bool added;
+			uint32_t symbol = customers->intern(name, added);
+			if (!added) {
+				return false;
+			}
+			Customer* customer = customers->insert(symbol, ID, result);
+			customer->num = num;
+			customer->priority = priority;
+			customer->seq = seq;
+			customers->setArea(customer, area);
+			FIFO->pushBack(customer);
+			if (area == area1) {
+				if (!area_1->restore(customer, slot)) {
+					return false;
 				}
-				delete temp;
-				size--;
 			} else {
-				// Two children case
-				Node* temp = minValueNode(node->right);
-				node->result = temp->result;
-				node->ID = temp->ID;
-				node->name = temp->name;
-				node->num = temp->num;
-				node->right = remove(node->right, temp->result, temp->name);
+				tree_index[i] = tree.size();
+				tree.push_back(customer);
 			}
-		} else {
-			//return node;
-			node->left = remove(node->left, result, name);
-			node->right = remove(node->right, result, name);
+			order[i] = customer;
 		}
-		if (node == nullptr) {
-			return node;
+		// children as indexes among the area 2 customers, -1 for none or not in area 2
+		auto treeIndexOf = [&](int i) {
+			return i < 0 || i >= count ? -1 : tree_index[i];
+		};
+		vector<int> tree_left, tree_right, tree_height;
+		for (int i = 0; i < count; i++) {
+			if (tree_index[i] < 0) {
+				continue;
+			}
+			if ((left[i] >= 0 && treeIndexOf(left[i]) < 0) || (right[i] >= 0 && treeIndexOf(right[i]) < 0)) {
+				return false;
+			}
+			tree_left.push_back(treeIndexOf(left[i]));
+			tree_right.push_back(treeIndexOf(right[i]));
+			tree_height.push_back(height[i]);
 		}
-
-		updateHeight(node);
-		// ll
-		int balance = getBalance(node);
-		if (balance > 1 && getBalance(node->left) >= 0) {
-			return rotateRight(node);
+		// an index listed twice would link one record into LRCO twice
+		vector<bool> in_lrco(count, false);
+		for (int i = 0; i < count; i++) {
+			uint32_t index = in.get<uint32_t>();
+			if (index >= (uint32_t)count || in_lrco[index]) {
+				return false;
+			}
+			in_lrco[index] = true;
+			LRCO->pushBack(order[index]);
 		}
-		// lr
-		if (balance > 1 && getBalance(node->left) < 0) {
-			node->left = rotateLeft(node->left);
-			return rotateRight(node);
+		vector<Customer*> heap(count);
+		vector<bool> in_heap(count, false);
+		for (int i = 0; i < count; i++) {
+			uint32_t index = in.get<uint32_t>();
+			if (index >= (uint32_t)count || in_heap[index]) {
+				return false;
+			}
+			in_heap[index] = true;
+			heap[i] = order[index];
 		}
-		// rr
-		if (balance < -1 && getBalance(node->right) <= 0) {
-			return rotateLeft(node);
+		int root = in.get<int32_t>();
+		if ((root >= 0 && treeIndexOf(root) < 0) || !LFCO->restore(heap, increase_num)
+			|| !area_2->restore(tree, tree_left, tree_right, tree_height, treeIndexOf(root), next_seq)) {
+			return false;
 		}
-		// rl
-		if (balance < -1 && getBalance(node->right) > 0) {
-			node->right = rotateRight(node->right);
-			return rotateLeft(node);
+		uint32_t tombstones = in.get<uint32_t>();
+		for (uint32_t i = 0; i < tombstones && in.isOk(); i++) {
+			if (!area_1->restoreTombstone(in.get<int32_t>())) {
+				return false;
+			}
 		}
-
-		return node;
+		return in.isOk() && in.atEnd() && LRCO->getSize() == count;
 	}
 public:
-	AVLTree() {
-		size = 0;
-		root = nullptr;
+	static const uint32_t SNAPSHOT_VERSION = 1;
+	// more tables are cut to this. It keeps 2 * capacity in int and stops a
+	// damaged snapshot header from asking for gigabytes
+	static const int MAX_CAPACITY = 1 << 22;
+	// bytes a snapshot needs per customer at least: the record with an empty
+	// name, its LRCO index and its heap index
+	static const int MIN_SNAPSHOT_RECORD = 48;
+
+	Restaurant(int capacity = MAXSIZE, ostream* out = &cout) {
+		build(capacity);
+		heapify_wipe = false;
+		own_out = new OutputSink(*out);
+		this->out = own_out;
+	}
+	Restaurant(int capacity, OutputSink* out) : Restaurant(capacity) {
+		setOutput(out);
 	}
-	~AVLTree() {
-		deleteAVLTree(root);
+	~Restaurant() {
+		destroy();
+		delete own_out;
 	}
 
-	void clear() {
-		deleteAVLTree(root);
+	int getCapacity() {
+		return capacity;
 	}
-	
-	int getSize() {
-		return this->size;
+
+	void setOutput(ostream* out) {
+		delete own_out;
+		own_out = new OutputSink(*out);
+		this->out = own_out;
 	}
-	bool isFull() {
-		return this->size >= max_size;
+
+	// the sink stays the caller's and must outlive the restaurant or the next setOutput
+	void setOutput(OutputSink* out) {
+		delete own_out;
+		own_out = nullptr;
+		this->out = out;
 	}
 
-	void insert(int ID, int result, string name) {
-		if (this->size >= max_size) {
-			return;
-		}
-		root = insert(root, ID, result, name);
+	// area wipes rebuild LFCO in O(n) instead of O(k log n), see cle. Off by
+	// default because PrintMH then no longer matches the reference order, except
+	// after a wipe that leaves at most 2 customers, which always rebuilds
+	void setHeapifyWipe(bool on) {
+		heapify_wipe = on;
 	}
 
-	void updateNum(int result, string name) {
-		if (this->size <= 0) {
-			return;
+	// the whole state in a versioned binary file: header, then the customers in
+	// FIFO order with their area 1 slot / area 2 children, the LRCO order and
+	// the LFCO heap as indexes into that list, the AVL root and the area 1 tombstones
+	bool saveSnapshot(string filename) {
+		int count = FIFO->getSize();
+		vector<int32_t> index(customers->getSymbolCount(), -1); // by symbol
+		int i = 0;
+		for (Customer* customer = FIFO->getHead(); customer; customer = FIFO->next(customer)) {
+			index[customer->name] = i++;
+		}
+		auto indexOf = [&](Customer* customer) {
+			return customer == nullptr ? -1 : index[customer->name];
+		};
+
+		SnapshotWriter snapshot;
+		snapshot.putBytes("RSNP");
+		snapshot.put<uint32_t>(SNAPSHOT_VERSION);
+		snapshot.put<uint32_t>(capacity);
+		snapshot.put<uint32_t>(count);
+		snapshot.put<int64_t>(area_2->getNextSeq());
+		snapshot.put<int32_t>(LFCO->getIncreaseNum());
+		for (Customer* customer = FIFO->getHead(); customer; customer = FIFO->next(customer)) {
+			string_view name = customers->name(customer);
+			snapshot.put<uint32_t>(customer->ID);
+			snapshot.put<uint16_t>(customer->result);
+			snapshot.put<uint8_t>(customer->area);
+			snapshot.put<uint8_t>(customer->area == area2 ? area_2->getHeight(customer) : 1);
+			snapshot.put<uint32_t>(customer->num);
+			snapshot.put<int32_t>(customer->priority);
+			snapshot.put<int32_t>(customer->slot);
+			snapshot.put<int64_t>(customer->seq);
+			snapshot.put<int32_t>(customer->area == area2 ? indexOf(area_2->getLeft(customer)) : -1);
+			snapshot.put<int32_t>(customer->area == area2 ? indexOf(area_2->getRight(customer)) : -1);
+			snapshot.put<uint32_t>(name.size());
+			snapshot.putBytes(name);
+		}
+		for (Customer* customer = LRCO->getHead(); customer; customer = LRCO->next(customer)) {
+			snapshot.put<uint32_t>(indexOf(customer));
+		}
+		for (int pos = 0; pos < LFCO->getSize(); pos++) {
+			snapshot.put<uint32_t>(indexOf(LFCO->at(pos)));
 		}
-		updateNum(root, result, name);
+		snapshot.put<int32_t>(indexOf(area_2->getRoot()));
+		vector<int32_t> tombstones;
+		for (int slot = 0; slot < area_1->getSlotCount(); slot++) {
+			if (area_1->isTombstone(slot)) {
+				tombstones.push_back(slot);
+			}
+		}
+		snapshot.put<uint32_t>(tombstones.size());
+		for (int32_t slot : tombstones) {
+			snapshot.put<int32_t>(slot);
+		}
+		return snapshot.save(filename);
 	}
 
-	void remove(int result, string name) {
-		if (this->size <= 0) {
-			return;
+	// replaces the whole state (capacity included) with a snapshot, in time
+	// linear in its size. It is restored on the side and swapped in at the end,
+	// so a file that is not a valid snapshot changes nothing
+	bool loadSnapshot(string filename) {
+		MappedFile file(filename);
+		SnapshotReader in(file.getData(), file.getSize());
+		if (in.getBytes(4) != "RSNP" || in.get<uint32_t>() != SNAPSHOT_VERSION) {
+			return false;
+		}
+		uint32_t snapshot_capacity = in.get<uint32_t>();
+		uint32_t count = in.get<uint32_t>();
+		long long next_seq = in.get<int64_t>();
+		int increase_num = in.get<int32_t>();
+		// the root and the tombstone count follow the customers
+		if (!in.isOk() || snapshot_capacity < 2 || snapshot_capacity > MAX_CAPACITY || count > snapshot_capacity
+			|| (uint64_t)count * MIN_SNAPSHOT_RECORD + 8 > in.getRemaining()) {
+			return false;
+		}
+		Restaurant loaded(snapshot_capacity);
+		if (!loaded.restoreCustomers(in, count, next_seq, increase_num)) {
+			return false;
 		}
-		root = remove(root, result, name);
+		swapState(loaded);
+		return true;
 	}
 
-	void print() {
-		// print bfs
-		// "ID-result-num"
-		if (size <= 0) {
-			return;
+	// returns which command the line was, cmdUnknown lines are ignored.
+	// huff_result: the Huffman result of a REG name when it is known, -1 = not known.
+	// computed, if set, gets the Huffman result a new customer was seated with, else -1
+	Command execute(string_view command, int huff_result = -1, int* computed = nullptr) {
+		if (computed != nullptr) {
+			*computed = -1;
+		}
+		string_view key = command.substr(0, command.find(" "));
+		Command type = getCommand(key);
+#if RESTAURANT_STATS
+		bool timed = stats.sample(type);
+		chrono::steady_clock::time_point start;
+		if (timed) {
+			start = chrono::steady_clock::now();
+		}
+#endif
+		Outcome outcome = outcomeUnknown;
+		switch (type) {
+			case cmdREG:
+				outcome = reg(command, FIFO, LRCO, LFCO, *customers, area_1, area_2, capacity, *huff_cache, huff_result, computed);
+				break;
+			case cmdCLE:
+				outcome = cle(command, FIFO, LRCO, LFCO, *customers, area_1, area_2, capacity, heapify_wipe);
+				break;
+			case cmdPrintHT:
+				printHT(area_1, *out);
+				out->flush();
+				outcome = outcomePrintHT;
+				break;
+			case cmdPrintAVL:
+				printAVL(area_2, *out);
+				out->flush();
+				outcome = outcomePrintAVL;
+				break;
+			case cmdPrintMH:
+				printMH(LFCO, *out);
+				out->flush();
+				outcome = outcomePrintMH;
+				break;
+			case cmdSnapshot:
+				if (command.size() > 4) { // "SNP filename"
+					saveSnapshot(string(command.substr(4)));
+				}
+				outcome = outcomeSnapshot;
+				break;
+			default:
+				break;
 		}
-		queue<Node*> q;
-		q.push(root);
+#if RESTAURANT_STATS
+		stats.count(outcome);
+		if (timed) {
+			stats.record(outcome, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+		}
+#else
+		(void)outcome;
+#endif
+		return type;
+	}
 
-		while (!q.empty()) {
-			Node* node = q.front();
-			q.pop();
-			if (node->left != nullptr) {
-				q.push(node->left);
-			}
-			if (node->right != nullptr) {
-				q.push(node->right);
-			}
-			cout << node->ID << "-" << node->result << "-" << node->num << endl;
+	// a copy of what the three Print commands would print now
+	PrintView* makeView() {
+		PrintView* view = new PrintView();
+		{
+			OutputSink sink(view->ht);
+			printHT(area_1, sink);
 		}
+		{
+			OutputSink sink(view->avl);
+			printAVL(area_2, sink);
+		}
+		{
+			OutputSink sink(view->mh);
+			printMH(LFCO, sink);
+		}
+		view->commands = 0;
+		return view;
+	}
+
+	// stats as JSON, "{}" when built with RESTAURANT_STATS=0
+	void writeStats(ostream& out) {
+#if RESTAURANT_STATS
+		stats.writeJSON(out);
+#else
+		out << "{}" << endl;
+#endif
 	}
 };
 
-class LinkedList {
+// a restaurant whose Print commands can also be served by other threads.
+// One mutator thread runs execute(). It only hands its REG/CLE lines (with the
+// Huffman results it already computed) to a publisher thread, which replays
+// them on a replica of the restaurant and, once publish_every of them have
+// been applied, swaps in a PrintView of the replica. Reader threads print the
+// latest view with print() without taking a lock. Neither printing nor
+// rendering a view runs on the mutator, at the price of a second copy of the
+// state and of views that lag the mutator by the publisher's backlog
+class LiveRestaurant {
 private:
-	class Node {
+	// REG/CLE lines for the replica, '\n' terminated, and the Huffman result of each
+	class Batch {
 	public:
-		int result;
-		int ID;
-		string name;
-		Node* next;
-		Area area;
-
-		Node() {
-			result = 0;
-			ID = 0;
-			name = "";
-			next = NULL;
-		}
-
-		Node(int result, int ID, string name, Area area) {
-			this->result = result;
-			this->ID = ID;
-			this->name = name;
-			this->next = NULL;
-			this->area = area;
-		}
+		string lines;
+		vector<int> results;
+		long long commands; // the mutator's count after the last of them
 	};
-	Node* head;
-	int size;
+	static const int HANDOFF = 256; // REG/CLE per handoff to the publisher
+	static const size_t MAX_BACKLOG = 1 << 20; // the mutator waits past this many queued
 
-	void deleteLinkedlist(Node* node) {
-		if (node == NULL) {
+	Restaurant restaurant;
+	OutputSink discard;
+	Restaurant replica; // the publisher's, never prints
+	atomic<PrintView*> current;
+	EpochDomain epochs;
+	int publish_every;
+	long long commands; // run by execute
+	Batch outbox; // mutator only
+	mutex lock;
+	condition_variable changed;
+	Batch inbox; // lock
+	long long wanted; // lock: publish() waits for a view of this command
+	long long published; // lock: command count of the current view
+	bool stopping; // lock
+	thread publisher;
+
+	// mutator: outbox goes to the publisher, after waiting out a full backlog
+	void handOff() {
+		if (outbox.results.empty()) {
 			return;
 		}
-		deleteLinkedlist(node->next);
-		delete node;
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this] { return inbox.results.size() < MAX_BACKLOG; });
+		inbox.lines += outbox.lines;
+		inbox.results.insert(inbox.results.end(), outbox.results.begin(), outbox.results.end());
+		inbox.commands = outbox.commands;
+		changed.notify_all();
+		outbox.lines.clear();
+		outbox.results.clear();
 	}
 
+	// publisher thread: applies what the mutator handed off, renders a view
+	// every publish_every changes or when publish() asks for one
+	void publishLoop() {
+		Batch work;
+		long long applied = 0; // command count of the replica
+		long long since_view = 0;
+		while (true) {
+			bool render;
+			{
+				unique_lock<mutex> guard(lock);
+				changed.wait(guard, [this, applied] { return stopping || !inbox.results.empty() || wanted > published; });
+				if (stopping) {
+					return;
+				}
+				swap(work, inbox);
+				if (!work.results.empty()) {
+					applied = work.commands;
+				}
+				changed.notify_all(); // room in the backlog
+				render = wanted > published;
+			}
+			size_t pos = 0;
+			for (int result : work.results) {
+				size_t end = work.lines.find('\n', pos);
+				replica.execute(string_view(work.lines).substr(pos, end - pos), result);
+				pos = end + 1;
+			}
+			since_view += work.results.size();
+			work.lines.clear();
+			work.results.clear();
+			if (!render && since_view < publish_every) {
+				continue;
+			}
+			PrintView* view = replica.makeView();
+			view->commands = applied;
+			epochs.retire(current.exchange(view));
+			since_view = 0;
+			lock_guard<mutex> guard(lock);
+			published = applied;
+			changed.notify_all();
+		}
+	}
 public:
-	LinkedList() {
-		size = 0;
-		head = nullptr;
+	// readers = how many threads call print, each with its own reader number
+	LiveRestaurant(int capacity, int readers, int publish_every = 4096, ostream* out = &cout)
+		: restaurant(capacity, out), discard([](const char*, size_t) {}), replica(capacity, &discard), epochs(readers) {
+		this->publish_every = max(publish_every, 1);
+		commands = 0;
+		outbox.commands = 0;
+		inbox.commands = 0;
+		wanted = 0;
+		published = 0;
+		stopping = false;
+		current = replica.makeView();
+		current.load()->commands = 0;
+		publisher = thread(&LiveRestaurant::publishLoop, this);
 	}
-
-	~LinkedList() {
-		deleteLinkedlist(head);
-		this->size = 0;
+	~LiveRestaurant() {
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+			changed.notify_all();
+		}
+		publisher.join();
+		delete current.load();
 	}
 
-	void insertNode(int result, int ID, string name, Area area) {
-		Node* newNode = new Node(result, ID, name, area);
-		
-		if(head == NULL) {
-			head = newNode;
-			size++;
-			return;
+	// mutator thread only. Print commands run here print the live state to out
+	Command execute(string_view command) {
+		int computed;
+		Command type = restaurant.execute(command, -1, &computed);
+		commands++;
+		if (type == cmdREG || type == cmdCLE) {
+			outbox.lines.append(command.data(), command.size());
+			outbox.lines += '\n';
+			outbox.results.push_back(computed);
+			outbox.commands = commands;
+			if ((int)outbox.results.size() >= HANDOFF) {
+				handOff();
+			}
 		}
+		return type;
+	}
 
-		Node* temp = head;
-		while(temp->next != NULL) {
-			temp = temp->next;
-		}
+	// mutator thread only: waits until readers see the current state
+	void publish() {
+		handOff();
+		unique_lock<mutex> guard(lock);
+		wanted = outbox.commands;
+		changed.notify_all();
+		changed.wait(guard, [this] { return published >= wanted; });
+	}
 
-		temp->next = newNode;
-		size++;
+	// reader thread reader: prints the latest view for a PrintHT, PrintAVL or
+	// PrintMH command, false for any other. at = how many commands the view is from
+	bool print(int reader, Command type, OutputSink& out, long long* at = nullptr) {
+		if (type != cmdPrintHT && type != cmdPrintAVL && type != cmdPrintMH) {
+			return false;
+		}
+		epochs.enter(reader);
+		PrintView* view = current.load();
+		out.write(type == cmdPrintHT ? view->ht : type == cmdPrintAVL ? view->avl : view->mh);
+		if (at != nullptr) {
+			*at = view->commands;
+		}
+		epochs.leave(reader);
+		out.flush();
+		return true;
 	}
 
-	void removeHead() {
-		Node* temp = head;
-		head = head->next;
-		delete temp;
-		size--;
+	// the views still waiting for readers to let go of them
+	size_t getRetired() {
+		return epochs.getRetired();
 	}
 
-	int getSize() {
-		return this->size;
+	Restaurant& getRestaurant() {
+		return restaurant;
 	}
+};
 
-	void updateNum(int result, string name) {
-		if (head->name == name) {
-			insertNode(head->result, head->ID, head->name, head->area);
-			removeHead();
-			return;
+// many independent restaurants run by a work-stealing thread pool.
+// submit() queues a command for one instance, run() executes everything queued.
+// An instance is a single task, so its commands run (and print) in order;
+// the Print output of each instance is kept in its own buffer until takeOutput()
+class Engine {
+private:
+	class Instance {
+	public:
+		Restaurant* restaurant;
+		string output;
+		OutputSink* sink; // appends to output
+		vector<string> pending;
+	};
+	// one per worker: the owner takes from the back, idle workers steal from the front
+	class TaskQueue {
+	public:
+		mutex lock;
+		deque<int> tasks; // instance indexes
+	};
+	vector<Instance*> instances;
+
+	bool popTask(vector<TaskQueue*>& queues, int self, int& task) {
+		int count = queues.size();
+		for (int i = 0; i < count; i++) {
+			TaskQueue* queue = queues[(self + i) % count];
+			lock_guard<mutex> guard(queue->lock);
+			if (queue->tasks.empty()) {
+				continue;
+			}
+			if (i == 0) {
+				task = queue->tasks.back();
+				queue->tasks.pop_back();
+			} else {
+				task = queue->tasks.front();
+				queue->tasks.pop_front();
+			}
+			return true;
 		}
+		return false;
+	}
 
-		Node* temp = head;
-		Node* prev = nullptr;
-		while (temp && temp->name != name) {
-			prev = temp;
-			temp = temp->next;
+	void work(vector<TaskQueue*>& queues, int self, atomic<int>& remaining) {
+		int task;
+		while (remaining.load() > 0) {
+			if (!popTask(queues, self, task)) {
+				this_thread::yield();
+				continue;
+			}
+			Instance* instance = instances[task];
+			for (const string& command : instance->pending) {
+				instance->restaurant->execute(command);
+			}
+			instance->pending.clear();
+			remaining--;
 		}
-		if (temp == nullptr) {
-			return;
+	}
+public:
+	Engine(int count, int capacity = MAXSIZE) {
+		for (int i = 0; i < count; i++) {
+			Instance* instance = new Instance();
+			instance->sink = new OutputSink(instance->output);
+			instance->restaurant = new Restaurant(capacity, instance->sink);
+			instances.push_back(instance);
+		}
+	}
+	~Engine() {
+		for (Instance* instance : instances) {
+			delete instance->restaurant;
+			delete instance->sink;
+			delete instance;
 		}
+	}
 
-		insertNode(temp->result, temp->ID, temp->name, temp->area);
-		prev->next = temp->next;
-		delete temp;
-		size--;
+	int getSize() {
+		return instances.size();
 	}
-	Node* getHead() {
-		return head;
+
+	Restaurant& getInstance(int index) {
+		return *instances[index]->restaurant;
 	}
 
-	void removeNode(int result, string name) {
-		if (head->name == name) {
-			removeHead();
-			return;
+	void submit(int index, string_view command) {
+		instances[index]->pending.emplace_back(command);
+	}
+
+	// threads = workers including the calling thread
+	void run(int threads) {
+		if (threads < 1) {
+			threads = 1;
 		}
-		Node* temp = head;
-		Node* prev = nullptr;
-		while (temp && temp->name != name) {
-			prev = temp;
-			temp = temp->next;
+		vector<TaskQueue*> queues;
+		for (int i = 0; i < threads; i++) {
+			queues.push_back(new TaskQueue());
 		}
-		if (temp == nullptr) {
-			return;
+		int tasks = 0;
+		for (int i = 0; i < (int)instances.size(); i++) {
+			if (!instances[i]->pending.empty()) {
+				queues[tasks % threads]->tasks.push_back(i);
+				tasks++;
+			}
 		}
-		prev->next = temp->next;
-		delete temp;
-		size--;
+		atomic<int> remaining(tasks);
+		vector<thread> workers;
+		for (int i = 1; i < threads; i++) {
+			workers.emplace_back(&Engine::work, this, ref(queues), i, ref(remaining));
+		}
+		work(queues, 0, remaining);
+		for (thread& worker : workers) {
+			worker.join();
+		}
+		for (TaskQueue* queue : queues) {
+			delete queue;
+		}
+	}
+
+	// the Print output of one instance since the last call
+	string takeOutput(int index) {
+		string output;
+		output.swap(instances[index]->output);
+		return output;
+	}
+};
+
+// simulate in three stages: the calling thread cuts the command file into
+// batches, workers compute the Huffman result of every REG name in a batch and
+// one applier thread runs the batches through the restaurant in file order.
+// The result is the only thing reg() needs from the name alone, so the output
+// is the same as simulate's
+class Pipeline {
+private:
+	class Batch {
+	public:
+		vector<string_view> lines;
+		vector<int> results; // -1 = not a REG with a valid name
+		bool computed;
+	};
+	static const int BATCH_LINES = 4096;
+
+	Restaurant& restaurant;
+	int threads;
+	vector<Batch> batches; // ring of the batches in flight
+	long long filled; // batches handed to the workers so far
+	long long applied; // batches the applier is done with
+	deque<long long> work; // batch numbers waiting for a worker
+	bool reading_done;
+	mutex lock;
+	condition_variable changed; // any of the above changed
 
+	Batch& batchOf(long long number) {
+		return batches[number % batches.size()];
 	}
 
-	vector<tuple<int, int, string>> getArea1IDListAndDelete() {
-		vector<tuple<int, int, string>> result;
-		Node* temp = head;
-		while (temp) {
-			if (temp->area == 1) {
-				result.push_back(make_tuple(temp->ID, temp->result, temp->name));
-				Node* prev = temp;
-				temp = temp->next;
-				removeNode(prev->result, prev->name);
+	void compute(Batch& batch, HuffCache& huff_cache) {
+		batch.results.assign(batch.lines.size(), -1);
+		for (size_t i = 0; i < batch.lines.size(); i++) {
+			string_view line = batch.lines[i];
+			if (getCommand(line.substr(0, line.find(" "))) != cmdREG || line == "REG" || line == "REG ") {
 				continue;
 			}
-			temp = temp->next;
+			string_view name = line.substr(line.find(" ") + 1);
+			if (checkName(name)) {
+				batch.results[i] = huff_cache.getResult(name);
+			}
 		}
-		return result;
 	}
 
-	void deleteArea1() {
-		Node* temp = head;
-		while (temp) {
-			if (temp->area == 1) {
-				removeNode(temp->result, temp->name);
+	void work_loop() {
+		HuffCache huff_cache(4096);
+		unique_lock<mutex> guard(lock);
+		while (true) {
+			changed.wait(guard, [this] { return !work.empty() || reading_done; });
+			if (work.empty()) {
+				return;
 			}
-			temp = temp->next;
+			long long number = work.front();
+			work.pop_front();
+			guard.unlock();
+			compute(batchOf(number), huff_cache);
+			guard.lock();
+			batchOf(number).computed = true;
+			changed.notify_all();
 		}
 	}
-	vector<tuple<int, int, string>> getArea2IDListAndDelete() {
-		vector<tuple<int, int, string>> result;
-		Node* temp = head;
-		while (temp) {
-			if (temp->area == 2) {
-				result.push_back(make_tuple(temp->ID, temp->result, temp->name));
-				Node* prev = temp;
-				temp = temp->next;
-				removeNode(prev->result, prev->name);
-				continue;
+
+	void apply_loop() {
+		for (long long number = 0; ; number++) {
+			unique_lock<mutex> guard(lock);
+			changed.wait(guard, [&] { return (number < filled && batchOf(number).computed) || (reading_done && number == filled); });
+			if (number == filled) {
+				return;
 			}
-			temp = temp->next;
+			guard.unlock();
+			Batch& batch = batchOf(number);
+			for (size_t i = 0; i < batch.lines.size(); i++) {
+				restaurant.execute(batch.lines[i], batch.results[i]);
+			}
+			guard.lock();
+			applied = number + 1;
+			changed.notify_all();
 		}
-		return result;
 	}
+public:
+	// threads = Huffman workers, the applier is one more thread
+	Pipeline(Restaurant& restaurant, int threads) : restaurant(restaurant) {
+		this->threads = max(threads, 1);
+		batches.resize(4 * this->threads + 2);
+		filled = 0;
+		applied = 0;
+		reading_done = false;
+	}
+
+	// every line of reader, the views must stay valid until run returns
+	void run(CommandReader& reader) {
+		vector<thread> workers;
+		for (int i = 0; i < threads; i++) {
+			workers.emplace_back(&Pipeline::work_loop, this);
+		}
+		thread applier(&Pipeline::apply_loop, this);
 
-	void deleteArea2() {
-		Node* temp = head;
-		while (temp) {
-			if (temp->area == 2) {
-				removeNode(temp->result, temp->name);
+		string_view line;
+		bool more = true;
+		for (long long number = 0; more; number++) {
+			{
+				unique_lock<mutex> guard(lock);
+				changed.wait(guard, [&] { return number - applied < (long long)batches.size(); });
 			}
-			temp = temp->next;
+			Batch& batch = batchOf(number);
+			batch.lines.clear();
+			while ((int)batch.lines.size() < BATCH_LINES && (more = reader.next(line))) {
+				batch.lines.push_back(line);
+			}
+			if (batch.lines.empty()) {
+				break;
+			}
+			lock_guard<mutex> guard(lock);
+			batch.computed = false;
+			filled = number + 1;
+			work.push_back(number);
+			changed.notify_all();
+		}
+		{
+			lock_guard<mutex> guard(lock);
+			reading_done = true;
+			changed.notify_all();
+		}
+		for (thread& worker : workers) {
+			worker.join();
 		}
+		applier.join();
 	}
 };
 
-class MinHeap {
+// one restaurant served over a Unix domain socket. Clients send the lines of
+// a command file; every command is answered with what it printed followed by
+// an empty line (Print lines are never empty). The epoll loop reads every
+// connection that is ready, runs all the complete lines it got as one batch,
+// in order per connection, and then writes the answers back. Only REG, CLE
+// and the Prints run, anything else (SNP included) is answered as unknown.
+// A client with MAX_OUTPUT of unread answers is neither read nor run until
+// it has read some of them
+class CommandServer {
 private:
-	class Node {
+	class Connection {
 	public:
-		int ID;
-		int num;
-		int result;
-		string name;
-		int priority;
-		Node(int ID, int result, string name, int priority) {
-			this->ID = ID;
-			this->num = 1;
-			this->result = result;
-			this->name = name;
-			this->priority = priority;
-		}
-		Node(int ID, int result, string name, int num, int priority) {
-			this->ID = ID;
-			this->result = result;
-			this->name = name;
-			this->num = num;
-			this->priority = priority;
-		}
+		int fd;
+		string input; // read, not run yet
+		string output; // answers not sent yet
+		bool reading; // waiting for EPOLLIN
+		bool writing; // waiting for EPOLLOUT
+		bool closed; // the client hung up or failed
+		bool queued; // in the ready list of the current batch
 	};
+	static const int MAX_EVENTS = 256;
+	static const size_t READ_SIZE = 1 << 16;
+	static const size_t MAX_OUTPUT = 1 << 22; // stop running a client's commands while it has this much unread
+	static const size_t MAX_UNRUN = 1 << 22; // stop reading a client while it has this much not run
 
-	Node* heap[MAXSIZE];
-	int max_size = MAXSIZE;
-	int size;
-	int increase_num;
-
-	int parent(int i) {
-		return (i - 1) / 2;
-	}
-
-	int left(int i) {
-		return 2 * i + 1;
-	}
+	string path;
+	string* target; // the answer buffer the restaurant prints into
+	OutputSink sink;
+	Restaurant restaurant;
+	int listen_fd;
+	int epoll_fd;
+	int wake_fd; // stop() signals it
+	unordered_map<int, Connection*> connections;
+	vector<Connection*> waiting; // complete lines left over from the last batch
+	long long batches;
+	long long commands;
 
-	int right(int i) {
-		return 2 * i + 2;
+	static void setNonBlocking(int fd) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 	}
 
-	void swap(Node*& a, Node*& b) {
-		Node* temp = a;
-		a = b;
-		b = temp;
+	static bool hasLine(Connection* connection) {
+		return connection->input.find('\n') != string::npos;
 	}
 
-	void reheapUp(int pos) {
-		if (pos <= 0 || pos >= size) {
+	// EPOLLIN while the client is open and under both limits, EPOLLOUT while
+	// answers are pending
+	void watch(Connection* connection) {
+		bool reading = !connection->closed && connection->output.size() < MAX_OUTPUT && connection->input.size() < MAX_UNRUN;
+		bool writing = !connection->output.empty();
+		if (reading == connection->reading && writing == connection->writing) {
 			return;
 		}
-		if (heap[parent(pos)]->num > heap[pos]->num || (heap[parent(pos)]->num == heap[pos]->num && heap[parent(pos)]->priority > heap[pos]->priority)) {
-			swap(heap[parent(pos)], heap[pos]);
-			reheapUp(parent(pos));
+		epoll_event event;
+		event.events = 0;
+		if (reading) {
+			event.events |= EPOLLIN;
 		}
-	}
-
-	void reheapDown(int pos) {
-		if (pos < 0 || pos >= size - 1) {
-			return;
+		if (writing) {
+			event.events |= EPOLLOUT;
 		}
+		event.data.fd = connection->fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+		connection->reading = reading;
+		connection->writing = writing;
+	}
 
-		int l = left(pos); 
-		if (l > size-1) {
-			return;
+	void accept() {
+		while (true) {
+			int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+			if (fd < 0) {
+				return;
+			}
+			Connection* connection = new Connection();
+			connection->fd = fd;
+			connection->reading = true;
+			connection->writing = false;
+			connection->closed = false;
+			connection->queued = false;
+			connections[fd] = connection;
+			epoll_event event;
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
 		}
-		int r = right(pos);
-		int min_child;
+	}
 
-		if (r > size-1) {
-			min_child = l;
-		} else {
-			if (heap[l]->num < heap[r]->num || (heap[l]->num == heap[r]->num && heap[l]->priority < heap[r]->priority)) {
-				min_child = l;
+	// what the socket has now, up to MAX_UNRUN not run yet; false once the
+	// client is gone or sent a line longer than MAX_UNRUN
+	bool receive(Connection* connection) {
+		char buffer[READ_SIZE];
+		while (connection->input.size() < MAX_UNRUN) {
+			ssize_t got = ::read(connection->fd, buffer, READ_SIZE);
+			if (got > 0) {
+				connection->input.append(buffer, got);
+			} else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				return true;
+			} else if (got < 0 && errno == EINTR) {
+				continue;
 			} else {
-				min_child = r;
+				return false;
 			}
 		}
-
-		if (heap[pos]->num > heap[min_child]->num || (heap[pos]->num == heap[min_child]->num && heap[pos]->priority > heap[min_child]->priority)) {
-			swap(heap[pos], heap[min_child]);
-			reheapDown(min_child);
-		}
-	}
-public:
-	MinHeap() {
-		for (int i = 0; i < max_size; i++) {
-			heap[i] = nullptr;
-		}
-		this->size = 0;
-		this->max_size = MAXSIZE;
-		this->increase_num = 0;
+		return hasLine(connection);
 	}
-	~MinHeap() {
-		for (int i = 0; i < max_size; i++) {
-			if (heap[i]) {
-				delete heap[i];
+
+	// as much output as the socket takes, false if the client is gone
+	bool send(Connection* connection) {
+		size_t sent = 0;
+		while (sent < connection->output.size()) {
+			ssize_t wrote = ::send(connection->fd, connection->output.data() + sent, connection->output.size() - sent, MSG_NOSIGNAL);
+			if (wrote > 0) {
+				sent += wrote;
+			} else if (wrote < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			} else if (wrote < 0 && errno == EINTR) {
+				continue;
+			} else {
+				return false;
 			}
 		}
-		this->size = 0;
-		this->max_size = MAXSIZE;
-		this->increase_num = 0;
+		connection->output.erase(0, sent);
+		watch(connection);
+		return true;
 	}
 
-	void insert(int ID, int result, string name) {
-		if (this->size >= max_size) {
-			return;
-		}
-
-		Node* newNode = new Node(ID, result, name, increase_num++);
-		heap[size++] = newNode;
-		reheapUp(size-1);
+	void close(Connection* connection) {
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+		::close(connection->fd);
+		connections.erase(connection->fd);
+		delete connection;
 	}
 
-	void insert(Node* node) {
-		if (this->size >= max_size) {
-			return;
+	// the complete lines of every connection in ready, run as one batch. A
+	// connection stops at MAX_OUTPUT, the rest of its lines wait for a later batch
+	void runBatch(vector<Connection*>& ready) {
+		for (Connection* connection : ready) {
+			target = &connection->output;
+			size_t pos = 0;
+			while (connection->output.size() < MAX_OUTPUT) {
+				size_t end = connection->input.find('\n', pos);
+				if (end == string::npos) {
+					break;
+				}
+				string_view command = string_view(connection->input).substr(pos, end - pos);
+				switch (getCommand(command.substr(0, command.find(" ")))) {
+					case cmdREG:
+					case cmdCLE:
+					case cmdPrintHT:
+					case cmdPrintAVL:
+					case cmdPrintMH:
+						restaurant.execute(command);
+						break;
+					default: // SNP would let any client write files as the server
+						break;
+				}
+				connection->output.push_back('\n');
+				commands++;
+				pos = end + 1;
+			}
+			connection->input.erase(0, pos);
 		}
-		heap[size++] = node;
-		reheapUp(size-1);
+		target = nullptr;
+		batches++;
 	}
-
-	void updateNum(int result, string name) {
-		for (int i = 0; i < size; i++) {
-			if (heap[i]->name == name) {
-				Node* temp = new Node(heap[i]->ID, heap[i]->result, heap[i]->name, heap[i]->num, heap[i]->priority);
-				
-				temp->num++;
-				remove(i);
-				insert(temp);
-				return;
+public:
+	CommandServer(string path, int capacity = MAXSIZE)
+		: path(path), target(nullptr), sink([this](const char* data, size_t size) {
+			if (target != nullptr) {
+				target->append(data, size);
 			}
+		}), restaurant(capacity, &sink) {
+		listen_fd = -1;
+		epoll_fd = -1;
+		wake_fd = -1;
+		batches = 0;
+		commands = 0;
+	}
+	~CommandServer() {
+		while (!connections.empty()) {
+			close(connections.begin()->second);
+		}
+		if (listen_fd >= 0) {
+			::close(listen_fd);
+			unlink(path.c_str());
+		}
+		if (epoll_fd >= 0) {
+			::close(epoll_fd);
+		}
+		if (wake_fd >= 0) {
+			::close(wake_fd);
 		}
 	}
+	CommandServer(const CommandServer&) = delete;
+	CommandServer& operator=(const CommandServer&) = delete;
 
-	void remove(int pos) {
-		if (pos < 0 || pos >= size || size == 0) {
-			return;
+	// binds the socket (replacing a stale one at path), false if it can't
+	bool listen() {
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			return false;
 		}
-		delete heap[pos];
-		heap[pos] = heap[size-1];
-		heap[size-1] = nullptr;
-		size--;
-		reheapDown(pos);
+		memcpy(address.sun_path, path.data(), path.size());
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		epoll_fd = epoll_create1(0);
+		wake_fd = eventfd(0, EFD_NONBLOCK);
+		if (listen_fd < 0 || epoll_fd < 0 || wake_fd < 0) {
+			return false;
+		}
+		unlink(path.c_str());
+		if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || ::listen(listen_fd, 128) < 0) {
+			::close(listen_fd);
+			listen_fd = -1;
+			return false;
+		}
+		setNonBlocking(listen_fd);
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.fd = listen_fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+		event.data.fd = wake_fd;
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+		return true;
 	}
 
-
-	void remove(int result, string name) {
-		for (int i = 0; i < size; i++) {
-			if (heap[i]->name == name) {
-				remove(i);
+	// serves clients until stop()
+	void run() {
+		epoll_event events[MAX_EVENTS];
+		vector<Connection*> ready;
+		while (true) {
+			// lines left over from the last batch run now, without waiting
+			int count = epoll_wait(epoll_fd, events, MAX_EVENTS, waiting.empty() ? -1 : 0);
+			if (count < 0 && errno != EINTR) {
 				return;
 			}
+			ready.swap(waiting);
+			waiting.clear();
+			for (Connection* connection : ready) {
+				connection->queued = true;
+			}
+			for (int i = 0; i < count; i++) {
+				int fd = events[i].data.fd;
+				if (fd == wake_fd) {
+					return;
+				}
+				if (fd == listen_fd) {
+					accept();
+					continue;
+				}
+				auto found = connections.find(fd);
+				if (found == connections.end()) {
+					continue;
+				}
+				Connection* connection = found->second;
+				if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !receive(connection)) {
+					connection->closed = true;
+				}
+				if (!connection->queued) {
+					connection->queued = true;
+					ready.push_back(connection);
+				}
+			}
+			runBatch(ready);
+			for (Connection* connection : ready) {
+				connection->queued = false;
+				if (!send(connection) || (connection->closed && connection->output.empty() && !hasLine(connection))) {
+					close(connection);
+				} else if (hasLine(connection) && connection->output.size() < MAX_OUTPUT) {
+					waiting.push_back(connection);
+				}
+			}
 		}
 	}
 
-	Node* getHead() {
-		return heap[0];
+	// from any thread, run() returns after its current batch
+	void stop() {
+		uint64_t one = 1;
+		ssize_t wrote = ::write(wake_fd, &one, sizeof(one));
+		(void)wrote;
 	}
 
-	void removeTop() {
-		remove(0);
+	long long getBatches() {
+		return batches;
 	}
 
-	void print(int index) {
-		if (index >= size) {
-			return;
-		}
-		cout << heap[index]->ID << "-" << heap[index]->num << endl;
-		print(left(index));
-		print(right(index));
-	}
-	void print() {
-		print(0);
+	long long getCommands() {
+		return commands;
 	}
 };
 
-void reg(string command, LinkedList* FIFO, LinkedList* LRCO, MinHeap* LFCO, map<int, pair<int, string>>& table, HashTable* area_1, AVLTree* area_2) {
-	// check valid REG command
-	if (command == "REG" || command == "REG ") {
-		return;
-	}
+// knobs of the write-ahead log of simulate, log_prefix = "" turns it off
+class JournalConfig {
+public:
+	string log_prefix;               // files are <log_prefix>.<generation>.log / .snap
+	int sync_every = 64;             // REG/CLE per fsync of the log
+	int checkpoint_every = 1000000;  // REG/CLE per checkpoint, 0 = never
+};
 
-	string name = command.substr(command.find(" ") + 1);
-	if (!checkName(name)) {
-		return;
-	} 
+// write-ahead log of a Restaurant. Every REG/CLE is appended to the log of the
+// current generation before it runs and the log is fsynced once per sync_every
+// of them, so a crash loses at most the last unsynced batch. A checkpoint
+// writes snapshot g + 1, starts log g + 1 and then deletes generation g, so
+// snapshot g plus log g is always the whole state: recovery loads the newest
+// snapshot that is readable and replays the complete lines of its log.
+// The first log file that can't be opened, written or synced stops the
+// journal: nothing more is logged or counted as synced, see getError
+class Journal {
+private:
+	Restaurant& restaurant;
+	JournalConfig config;
+	string directory; // of log_prefix
+	string base;
+	long long generation; // 0 = an empty restaurant, no snapshot
+	int fd; // log of generation
+	string batch; // logged, not written yet
+	int batched;
+	int since_checkpoint;
+	long long synced; // commands of this journal that are durable
+	string error; // why the journal stopped, "" while it works
 
-	// get Huffcode
-	string Huff_string = getHuffString(name); 
-	if (Huff_string.size() > 15) {
-		int start = Huff_string.size() - 15;
-		int end = Huff_string.size() - 1;
-		Huff_string = Huff_string.substr(start, end - start + 1);
+	string fileOf(long long generation, string suffix) {
+		return config.log_prefix + "." + to_string(generation) + suffix;
 	}
-	
-
-	int result = convertBinToDec(Huff_string);
 
-	// MAIN FUNCTION
-	// check if result is [new_customer] or [new_order]
-	bool customerExists = false;
-	for (int i = 1; i <= MAXSIZE; i++) {
-		if (table[i].first != -1 && table[i].second == name) {
-			customerExists = true;
-			break;
+	// stops the journal, the pending batch is dropped and never counted as synced
+	bool fail(string what) {
+		if (error.empty()) {
+			error = what + " " + fileOf(generation, ".log") + ": " + strerror(errno);
 		}
-	}	
+		if (fd >= 0) {
+			close(fd);
+			fd = -1;
+		}
+		batch.clear();
+		batched = 0;
+		return false;
+	}
 
-	if (customerExists) { // [new_order]
-		// update LRCO, min_heap, area 1, area 2
-		LRCO->updateNum(result, name);
-		LFCO->updateNum(result, name);
-		area_1->updateNum(result, name);
-		area_2->updateNum(result, name);
-	} else { // [new_customer]
-		int ID;
-		if (FIFO->getSize() >= MAXSIZE) { // full
-		
-			int OPT = result % 3;
-			int rm_result;
-			string rm_name;
+	bool openLog() {
+		fd = open(fileOf(generation, ".log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		return fd >= 0 || fail("can't open");
+	}
 
-			switch (OPT) {
-				case 0: { // FIFO
-					rm_result = FIFO->getHead()->result;
-					rm_name = FIFO->getHead()->name;
-					ID = FIFO->getHead()->ID;
-					break;
-				}
-				case 1: { // LRCO
-					rm_result = LRCO->getHead()->result;
-					rm_name = LRCO->getHead()->name;
-					ID = LRCO->getHead()->ID;
-					break;
-				}
-				case 2: { // LFCO
-					rm_result = LFCO->getHead()->result;
-					rm_name = LFCO->getHead()->name;
-					ID = LFCO->getHead()->ID;
-					break;
-				}
-			}
+	// a rename or a new file is only durable once its directory is synced
+	void syncDirectory() {
+		int dir = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+		if (dir >= 0) {
+			fsync(dir);
+			close(dir);
+		}
+	}
 
-			area_1->remove(rm_result, rm_name);
-			area_2->remove(rm_result, rm_name);
-			FIFO->removeNode(rm_result, rm_name);
-			LRCO->removeNode(rm_result, rm_name);				LFCO->remove(rm_result, rm_name);
-			table[ID].first = -1;
+	// generations that have a snapshot file, newest first
+	vector<long long> snapshotGenerations() {
+		vector<long long> generations;
+		DIR* dir = opendir(directory.c_str());
+		if (dir == nullptr) {
+			return generations;
+		}
+		string prefix = base + ".";
+		while (dirent* entry = readdir(dir)) {
+			string_view name = entry->d_name;
+			if (name.size() <= prefix.size() + 5 || name.substr(0, prefix.size()) != prefix || name.substr(name.size() - 5) != ".snap") {
+				continue;
+			}
+			string_view number = name.substr(prefix.size(), name.size() - prefix.size() - 5);
+			long long generation;
+			auto parsed = from_chars(number.data(), number.data() + number.size(), generation);
+			if (parsed.ec == errc() && parsed.ptr == number.data() + number.size()) {
+				generations.push_back(generation);
+			}
+		}
+		closedir(dir);
+		sort(generations.rbegin(), generations.rend());
+		return generations;
+	}
 
+	// the files of every generation before this one
+	void removeOlder() {
+		for (long long old : snapshotGenerations()) {
+			if (old < generation) { // log first, a snapshot left behind is still found next time
+				unlink(fileOf(old, ".log").c_str());
+				unlink(fileOf(old, ".snap").c_str());
+			}
+		}
+		if (generation > 0) {
+			unlink(fileOf(0, ".log").c_str());
+		}
+	}
+public:
+	Journal(Restaurant& restaurant, JournalConfig config) : restaurant(restaurant), config(config) {
+		size_t slash = config.log_prefix.rfind('/');
+		directory = slash == string::npos ? "." : config.log_prefix.substr(0, slash + 1);
+		base = slash == string::npos ? config.log_prefix : config.log_prefix.substr(slash + 1);
+		if (this->config.sync_every < 1) {
+			this->config.sync_every = 1;
+		}
+		generation = 0;
+		fd = -1;
+		batched = 0;
+		since_checkpoint = 0;
+		synced = 0;
+	}
+	~Journal() {
+		sync();
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+	Journal(const Journal&) = delete;
+	Journal& operator=(const Journal&) = delete;
 
-		} else { // not full
-			// find ID
-			ID = result % MAXSIZE + 1;
-
-			bool found = 0;
-			for (int i = 1; i <= MAXSIZE; i++) {
-				if (table[ID].first == -1) {
-					table[ID].first = result;
-					table[ID].second = name;
-					found = 1;
+	// brings the restaurant to the state of the last run and opens the log for
+	// appending, returns how many logged commands were replayed, -1 if the log
+	// can't be opened or truncated. A torn last line is cut off so new commands
+	// start on a line of their own
+	long long recover() {
+		generation = 0;
+		for (long long candidate : snapshotGenerations()) {
+			if (restaurant.loadSnapshot(fileOf(candidate, ".snap"))) {
+				generation = candidate;
+				break;
+			}
+		}
+		long long replayed = 0;
+		size_t complete = 0;
+		{
+			MappedFile log(fileOf(generation, ".log"));
+			const char* data = log.getData();
+			while (complete < log.getSize()) {
+				const char* end = (const char*)memchr(data + complete, '\n', log.getSize() - complete);
+				if (end == nullptr) {
 					break;
 				}
-				ID++;
-				if (ID > MAXSIZE) {
-					ID = 1;
-				}
+				restaurant.execute(string_view(data + complete, end - (data + complete)));
+				complete = end - data + 1;
+				replayed++;
 			}
+		}
+		if (fd >= 0) {
+			close(fd);
+		}
+		if (!openLog()) {
+			return -1;
+		}
+		if (ftruncate(fd, complete) != 0) {
+			fail("can't truncate");
+			return -1;
+		}
+		if (fsync(fd) != 0) {
+			fail("can't sync");
+			return -1;
+		}
+		syncDirectory();
+		removeOlder();
+		since_checkpoint = replayed;
+		return replayed;
+	}
 
-			if (!found) {
-				cout << "error" << endl;
-				return;
+	// logs a REG/CLE, then runs the command like Restaurant::execute. Once the
+	// journal has stopped commands still run but are no longer logged
+	Command execute(string_view command) {
+		Command type = getCommand(command.substr(0, command.find(" ")));
+		bool logged = (type == cmdREG || type == cmdCLE) && error.empty();
+		if (logged) {
+			batch.append(command.data(), command.size());
+			batch += '\n';
+			if (++batched >= config.sync_every) {
+				sync();
 			}
-		}	
-		// cout << result << "-" << ID << endl; // del
-		
-		// choose area
-		Area area;
-		if (result % 2 == 1) { // insert to area 1
-			if (area_1->isFull()) {
-				area_2->insert(ID, result, name);
-				area = area2;
-			} else {
-				area_1->insert(ID, result, name);
-				area = area1;
+		}
+		restaurant.execute(command);
+		if (logged && config.checkpoint_every > 0 && ++since_checkpoint >= config.checkpoint_every) {
+			checkpoint();
+		}
+		return type;
+	}
+
+	// writes and fsyncs the pending batch, false if the journal has stopped
+	bool sync() {
+		if (!error.empty()) {
+			return false;
+		}
+		if (batched == 0) {
+			return true;
+		}
+		if (fd < 0) {
+			errno = EBADF;
+			return fail("can't write");
+		}
+		size_t done = 0;
+		while (done < batch.size()) {
+			ssize_t written = ::write(fd, batch.data() + done, batch.size() - done);
+			if (written < 0 && errno == EINTR) {
+				continue;
 			}
-		} else { // insert to area 2
-			if (area_2->isFull()) {
-				area_1->insert(ID, result, name);
-				area = area1;
-			} else {
-				area_2->insert(ID, result, name);
-				area = area2;
+			if (written <= 0) {
+				if (written == 0) {
+					errno = EIO;
+				}
+				return fail("can't write");
 			}
+			done += written;
 		}
-		// update FIFO, LRCO, min_heap, table
-		FIFO->insertNode(result, ID, name, area);
-		LRCO->insertNode(result, ID, name, area);
-		LFCO->insert(ID, result, name);
-		table[ID].first = result;
-		table[ID].second = name;
+		if (fdatasync(fd) != 0) {
+			return fail("can't sync");
+		}
+		synced += batched;
+		batch.clear();
+		batched = 0;
+		return true;
 	}
-}
 
-void cle(string command, LinkedList* FIFO, LinkedList* LRCO, MinHeap* LFCO, map<int, pair<int, string>>& table, HashTable* area_1, AVLTree* area_2) {
-	// check valid CLE command
-	if (command == "CLE" || command == "CLE ") {
-		return;
+	// snapshot of the next generation and a fresh log, then the old files go.
+	// If the snapshot can't be written the current generation simply goes on
+	void checkpoint() {
+		since_checkpoint = 0;
+		if (!sync()) {
+			return;
+		}
+		if (!restaurant.saveSnapshot(fileOf(generation + 1, ".snap"))) {
+			return;
+		}
+		syncDirectory();
+		if (fd >= 0) {
+			close(fd);
+		}
+		generation++;
+		if (!openLog()) {
+			return;
+		}
+		syncDirectory();
+		removeOlder();
 	}
 
-	string NUM = command.substr(command.find(" ") + 1);
-	if (!checkID(NUM)) {
-		return;
-	} 
-	int ID = stoi(NUM);
-
-	if (ID < 1) {	// clear area 1
-		// update FIFO, LRCO, LFCO, min_heap, table, 
-		vector<tuple<int, int, string>> info_list = FIFO->getArea1IDListAndDelete();
-		for (auto x : info_list) {
-			//FIFO->removeNode(get<1>(x), get<2>(x));
-			LRCO->removeNode(get<1>(x), get<2>(x));
-			LFCO->remove(get<1>(x), get<2>(x));
-			area_1->remove(get<1>(x), get<2>(x));
-			table[get<0>(x)].first = -1;
-		}
-	} else if (ID > MAXSIZE) {	// clear area 2
-		vector<tuple<int, int, string>> info_list = FIFO->getArea2IDListAndDelete();
-		for (auto x : info_list) {
-			//FIFO->removeNode(get<1>(x), get<2>(x));
-			LRCO->removeNode(get<1>(x), get<2>(x));
-			LFCO->remove(get<1>(x), get<2>(x));
-			area_2->remove(get<1>(x), get<2>(x));
-			table[get<0>(x)].first = -1;
+	long long getGeneration() {
+		return generation;
+	}
+
+	long long getSynced() {
+		return synced;
+	}
+
+	bool isOk() {
+		return error.empty();
+	}
+
+	string getError() {
+		return error;
+	}
+};
+
+// stats_file: where to write the command stats as JSON at the end, "" = don't.
+// With journal.log_prefix set the state of the last run is recovered first and
+// the commands of filename go on from there, see Journal. A journal that stops
+// is reported on cerr and ends the run, so no command runs unlogged after it
+void simulate(string filename, int capacity = MAXSIZE, string stats_file = "", JournalConfig journal = JournalConfig())
+{
+	Restaurant restaurant(capacity);
+	CommandReader myfile(filename);
+	string_view command;
+	if (journal.log_prefix.empty()) {
+		while (myfile.next(command)) {
+			restaurant.execute(command);
 		}
 	} else {
-		if (table[ID].first != -1) {	// table is not empty
-			int result = table[ID].first;
-			string name = table[ID].second;
-			// update FIFO, LRCO, !min_heap, table, area
-			area_1->remove(result, name);
-			area_2->remove(result, name);
-			FIFO->removeNode(result, name);
-			LRCO->removeNode(result, name);
-			LFCO->remove(result, name);
-			table[ID].first = -1;
-		} else { // table is empty
-			// do nothing
-			return;
+		Journal log(restaurant, journal);
+		if (log.recover() >= 0) {
+			while (log.isOk() && myfile.next(command)) {
+				log.execute(command);
+			}
+			log.sync();
+		}
+		if (!log.isOk()) {
+			cerr << log.getError() << endl;
 		}
 	}
-}
+	if (!stats_file.empty()) {
+		ofstream out(stats_file);
+		restaurant.writeStats(out);
+	}
 
-void printHT(HashTable *area_1) {
-	area_1->print();
+	return;
 }
 
-void printAVL(AVLTree *area_2) {
-	area_2->print();
+// one restaurant per command file, run on threads workers; the outputs are
+// written one instance after another in the order of filenames
+void simulateMany(vector<string> filenames, int capacity = MAXSIZE, int threads = 1)
+{
+	Engine engine(filenames.size(), capacity);
+	for (int i = 0; i < (int)filenames.size(); i++) {
+		CommandReader myfile(filenames[i]);
+		string_view command;
+		while (myfile.next(command)) {
+			engine.submit(i, command);
+		}
+	}
+	engine.run(threads);
+	for (int i = 0; i < (int)filenames.size(); i++) {
+		cout << engine.takeOutput(i);
+	}
 }
 
-void printMH(MinHeap *LFCO) {
-	LFCO->print();
+// simulate with the Huffman results of REG names computed on threads workers
+// ahead of the restaurant, see Pipeline; prints the same as simulate
+void simulatePipelined(string filename, int capacity = MAXSIZE, int threads = 1, string stats_file = "")
+{
+	Restaurant restaurant(capacity);
+	CommandReader myfile(filename);
+	Pipeline pipeline(restaurant, threads);
+	pipeline.run(myfile);
+	if (!stats_file.empty()) {
+		ofstream out(stats_file);
+		restaurant.writeStats(out);
+	}
 }
 
-void simulate(string filename)
+// serves one restaurant on the Unix domain socket at path, see CommandServer
+void serve(string path, int capacity = MAXSIZE)
 {
-	LinkedList* FIFO = new LinkedList();
-	LinkedList* LRCO = new LinkedList();
-	HashTable* area_1 = new HashTable();
-	AVLTree* area_2 = new AVLTree();
-	MinHeap* LFCO = new MinHeap();
-
-	map<int, pair<int, string>> table; // .first = -1 is empty table
-	for (int i = 1; i <= MAXSIZE; i++) {
-		table[i].first = -1;
-	}
-	ifstream myfile(filename);
-	string command;
-	while (getline(myfile, command)) {
-		string key = command.substr(0, command.find(" "));
-		if (key == "REG") {
-			reg(command, FIFO, LRCO, LFCO, table, area_1, area_2);
-		} else if (key == "CLE") {
-			cle(command, FIFO, LRCO, LFCO, table, area_1, area_2);
-		} else if (key == "PrintHT") {
-			printHT(area_1);
-		} else if (key == "PrintAVL") {
-			printAVL(area_2);
-		} else if (key == "PrintMH") {
-			printMH(LFCO);
-		} else {
-			//
-			int n = 1;
-			//return;
-		}
+	CommandServer server(path, capacity);
+	if (!server.listen()) {
+		cerr << "can't listen on " << path << endl;
+		return;
 	}
-
-	delete FIFO;
-	delete LRCO;
-	delete LFCO;
-	delete area_1;
-	delete area_2;
-
-	return;
+	server.run();
 }